@@ -0,0 +1,571 @@
+// microbenchmarks of the detection post-processing and the OCR heuristics on synthetic inputs
+//
+// usage: bench_postproc [--filter substring] [--min_time seconds] [--json path]
+//
+// each benchmark is run until it takes at least min_time, then ns/op and allocations/op are reported
+// the inputs are sized after the real models: 300 rois and 37 classes per forward, 17 to 40 characters per field
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "detection_kernels.h"
+#include "data_utils/cv_extension.h"
+#include "data_utils/data_proc.hpp"
+#include "ocr_aux/collage.hpp"
+#include "ocr_aux/detection_proc.h"
+
+
+namespace {
+
+std::atomic<long> numAllocations(0);
+
+} // end namespace
+
+// every allocation of the process is counted, the benchmarks run on the main thread only
+void* operator new(std::size_t size) {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+
+namespace {
+
+using cz::Detection;
+using Clock = std::chrono::steady_clock;
+
+int const NUM_ROIS = 300;
+int const NUM_CLASSES = 37; // background, 0-9 and A-Z
+int const IMG_WIDTH = 1024;
+int const IMG_HEIGHT = 768;
+
+// keeps the compiler from discarding a result that is never read
+template<typename T>
+void doNotOptimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// drives the timed loop of a benchmark, work done while paused is excluded from both time and allocations
+class BenchState {
+public:
+    explicit BenchState(long numIterations) : numIterations_(numIterations) {}
+
+    bool keepRunning() {
+        if (remaining_ == numIterations_) {
+            resumeTiming();
+        }
+        if (remaining_-- > 0) return true;
+        pauseTiming();
+        return false;
+    }
+
+    void pauseTiming() {
+        elapsed_ += Clock::now() - start_;
+        allocations_ += numAllocations.load(std::memory_order_relaxed) - startAllocations_;
+    }
+
+    void resumeTiming() {
+        startAllocations_ = numAllocations.load(std::memory_order_relaxed);
+        start_ = Clock::now();
+    }
+
+    long numIterations() const { return numIterations_; }
+    double elapsedNs() const { return std::chrono::duration<double, std::nano>(elapsed_).count(); }
+    long allocations() const { return allocations_; }
+
+private:
+    long numIterations_;
+    long remaining_ = numIterations_;
+    Clock::time_point start_;
+    Clock::duration elapsed_ = Clock::duration::zero();
+    long startAllocations_ = 0;
+    long allocations_ = 0;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void(BenchState&)> run;
+};
+
+struct BenchResult {
+    std::string name;
+    long numIterations;
+    double nsPerOp;
+    double allocationsPerOp;
+};
+
+std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+void addBenchmark(std::string name, std::function<void(BenchState&)> run) {
+    registry().push_back(Benchmark{std::move(name), std::move(run)});
+}
+
+// grow the number of iterations until a run lasts at least minTimeSec
+BenchResult runBenchmark(Benchmark const& benchmark, double minTimeSec) {
+    long numIterations = 1;
+    while (true) {
+        BenchState state(numIterations);
+        benchmark.run(state);
+
+        double elapsedNs = state.elapsedNs();
+        if (elapsedNs >= minTimeSec * 1e9 || numIterations >= 1000000000L) {
+            return BenchResult{benchmark.name, numIterations, elapsedNs / numIterations,
+                               static_cast<double>(state.allocations()) / numIterations};
+        }
+
+        double multiplier = elapsedNs > 0 ? 1.4 * minTimeSec * 1e9 / elapsedNs : 10;
+        numIterations = std::max(numIterations + 1, static_cast<long>(numIterations * std::min(multiplier, 10.0)));
+    }
+}
+
+
+/* ------- Synthetic Inputs ------- */
+
+// the raw outputs of a detector forward: proposals clustered around a line of characters
+struct ForwardOutputs {
+    std::vector<float> boxes;      // NUM_ROIS x 4
+    std::vector<float> boxDeltas;  // NUM_ROIS x NUM_CLASSES x 4
+    std::vector<float> predCls;    // NUM_ROIS x NUM_CLASSES
+};
+
+ForwardOutputs makeForwardOutputs(std::mt19937& rng) {
+    std::normal_distribution<float> jitter(0, 3);
+    std::normal_distribution<float> delta(0, 0.05f);
+    std::uniform_int_distribution<int> charIdx(0, 39);
+    std::uniform_int_distribution<int> classIdx(1, NUM_CLASSES - 1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    ForwardOutputs outputs;
+    outputs.boxes.resize(NUM_ROIS * 4);
+    outputs.boxDeltas.resize(NUM_ROIS * NUM_CLASSES * 4);
+    outputs.predCls.resize(NUM_ROIS * NUM_CLASSES);
+
+    for (int i = 0; i < NUM_ROIS; ++i) {
+        float x = 100 + 20 * charIdx(rng) + jitter(rng);
+        float y = 300 + jitter(rng);
+        float* box = &outputs.boxes[i * 4];
+        box[0] = x;
+        box[1] = y;
+        box[2] = x + 16 + jitter(rng);
+        box[3] = y + 32 + jitter(rng);
+
+        for (int j = 0; j < NUM_CLASSES * 4; ++j) {
+            outputs.boxDeltas[i * NUM_CLASSES * 4 + j] = delta(rng);
+        }
+
+        // most of the probability goes to one class, the rest is spread over the others
+        float* cls = &outputs.predCls[i * NUM_CLASSES];
+        int dominant = classIdx(rng);
+        float peak = 0.5f + 0.5f * unit(rng);
+        for (int j = 0; j < NUM_CLASSES; ++j) {
+            cls[j] = (1 - peak) / (NUM_CLASSES - 1);
+        }
+        cls[dominant] = peak;
+    }
+    return outputs;
+}
+
+std::string charLabel(int idx) {
+    return std::string(1, idx < 10 ? static_cast<char>('0' + idx) : static_cast<char>('A' + idx - 10));
+}
+
+// a line of characters sorted by x, with duplicates and a few off-line outliers as a character detector yields
+std::vector<Detection> makeCharLine(std::mt19937& rng, int numChars, cv::Point origin = cv::Point(40, 300)) {
+    std::normal_distribution<float> jitter(0, 1.5f);
+    std::uniform_int_distribution<int> label(0, 35);
+    std::uniform_real_distribution<float> score(0.05f, 1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    std::vector<Detection> dets;
+    for (int i = 0; i < numChars; ++i) {
+        int x = origin.x + 20 * i + static_cast<int>(jitter(rng));
+        int y = origin.y + static_cast<int>(0.05 * 20 * i + jitter(rng));
+        dets.emplace_back(charLabel(label(rng)), cv::Rect(x, y, 16, 32), score(rng));
+
+        if (unit(rng) < 0.3f) {
+            dets.emplace_back(charLabel(label(rng)), cv::Rect(x + 3, y + 1, 15, 31), score(rng));
+        }
+        if (unit(rng) < 0.05f) {
+            dets.emplace_back(charLabel(label(rng)), cv::Rect(x, y + 40, 16, 32), score(rng));
+        }
+    }
+    cz::sortByXMid(dets);
+    return dets;
+}
+
+// the classes of the character detectors
+cz::LabelTable makeLabelTable() {
+    cz::LabelTable labels{"__background__"};
+    for (int i = 0; i < NUM_CLASSES - 1; ++i) {
+        labels.push_back(charLabel(i));
+    }
+    return labels;
+}
+
+enum class BenchField { F0 = 0, F1, F2, F3, F4, F5, F6, F7, F8 };
+int const NUM_BENCH_FIELDS = 9;
+
+constexpr size_t enumCapacity(BenchField) { return NUM_BENCH_FIELDS; }
+
+// value ROIs of the fields laid out as rows of a nameplate
+cz::EnumMap<BenchField, cv::Rect> makeFieldRois() {
+    cz::EnumMap<BenchField, cv::Rect> rois;
+    for (int i = 0; i < NUM_BENCH_FIELDS; ++i) {
+        rois[static_cast<BenchField>(i)] = cv::Rect(40 + 30 * (i % 3), 60 + 70 * i, 800, 44);
+    }
+    return rois;
+}
+
+// the detections of a whole image: a line of characters in every field ROI
+std::vector<Detection> makePageDetections(std::mt19937& rng, cz::EnumMap<BenchField, cv::Rect> const& rois) {
+    std::uniform_int_distribution<int> numChars(17, 40);
+
+    std::vector<Detection> dets;
+    for (auto const& roi : rois) {
+        std::vector<Detection> line = makeCharLine(rng, numChars(rng), roi.second.tl() + cv::Point(4, 6));
+        dets.insert(dets.end(), line.cbegin(), line.cend());
+    }
+    return dets;
+}
+
+
+/* ------- Benchmarks ------- */
+
+void registerDetectionKernels() {
+    std::mt19937 rng(42);
+    auto outputs = std::make_shared<ForwardOutputs>(makeForwardOutputs(rng));
+    auto labels = std::make_shared<cz::LabelTable const>(makeLabelTable());
+
+    // inputs of the per-class kernels are taken from the first class after the background
+    auto pred = std::make_shared<std::vector<float>>(NUM_ROIS * 5 * NUM_CLASSES);
+    cz::kernels::bbox_transform_inv(NUM_ROIS, NUM_CLASSES, outputs->boxDeltas.data(), outputs->predCls.data(),
+                           outputs->boxes.data(), pred->data(), IMG_HEIGHT, IMG_WIDTH);
+    auto sorted = std::make_shared<std::vector<float>>(NUM_ROIS * 5 * NUM_CLASSES);
+    for (int i = 0; i < NUM_CLASSES; ++i) {
+        cz::kernels::boxes_sort(NUM_ROIS, pred->data() + i * NUM_ROIS * 5, sorted->data() + i * NUM_ROIS * 5);
+    }
+
+    addBenchmark("bbox_transform_inv", [=](BenchState& state) {
+        std::vector<float> result(NUM_ROIS * 5 * NUM_CLASSES);
+        while (state.keepRunning()) {
+            cz::kernels::bbox_transform_inv(NUM_ROIS, NUM_CLASSES, outputs->boxDeltas.data(), outputs->predCls.data(),
+                                   outputs->boxes.data(), result.data(), IMG_HEIGHT, IMG_WIDTH);
+            doNotOptimize(result.data());
+        }
+    });
+
+    addBenchmark("boxes_sort", [=](BenchState& state) {
+        std::vector<float> result(NUM_ROIS * 5);
+        while (state.keepRunning()) {
+            cz::kernels::boxes_sort(NUM_ROIS, pred->data() + NUM_ROIS * 5, result.data());
+            doNotOptimize(result.data());
+        }
+    });
+
+    addBenchmark("nms", [=](BenchState& state) {
+        std::vector<int> keep(NUM_ROIS);
+        int numOut = 0;
+        while (state.keepRunning()) {
+            cz::kernels::nms(keep.data(), &numOut, sorted->data() + NUM_ROIS * 5, NUM_ROIS, 5, 0.3f);
+            doNotOptimize(numOut);
+        }
+    });
+
+    addBenchmark("overThresh", [=](BenchState& state) {
+        std::vector<int> keep(NUM_ROIS);
+        int numOut = 0;
+        cz::kernels::nms(keep.data(), &numOut, sorted->data() + NUM_ROIS * 5, NUM_ROIS, 5, 0.3f);
+        cz::DetectionSet dets(labels);
+        while (state.keepRunning()) {
+            dets.clear();
+            cz::kernels::overThresh(keep.data(), numOut, sorted->data() + NUM_ROIS * 5, 0.05f, 1, dets);
+            doNotOptimize(dets.size());
+        }
+    });
+
+    // the whole post-processing of one forward, as Detector::detect runs it
+    addBenchmark("detector_postproc", [=](BenchState& state) {
+        std::vector<float> result(NUM_ROIS * 5 * NUM_CLASSES);
+        std::vector<float> perClass(NUM_ROIS * 5), sortedPerClass(NUM_ROIS * 5);
+        std::vector<int> keep(NUM_ROIS);
+        while (state.keepRunning()) {
+            cz::kernels::bbox_transform_inv(NUM_ROIS, NUM_CLASSES, outputs->boxDeltas.data(), outputs->predCls.data(),
+                                   outputs->boxes.data(), result.data(), IMG_HEIGHT, IMG_WIDTH);
+            cz::DetectionSet dets(labels);
+            for (int i = 1; i < NUM_CLASSES; ++i) {
+                std::copy_n(result.data() + i * NUM_ROIS * 5, NUM_ROIS * 5, perClass.data());
+                cz::kernels::boxes_sort(NUM_ROIS, perClass.data(), sortedPerClass.data());
+                int numOut = 0;
+                cz::kernels::nms(keep.data(), &numOut, sortedPerClass.data(), NUM_ROIS, 5, 0.3f);
+                cz::kernels::overThresh(keep.data(), numOut, sortedPerClass.data(), 0.7f, i, dets);
+            }
+            doNotOptimize(dets.size());
+        }
+    });
+}
+
+void registerCharLineHeuristics(int numChars) {
+    std::mt19937 rng(numChars);
+    auto line = std::make_shared<std::vector<Detection>>(makeCharLine(rng, numChars));
+    std::string const suffix = "/" + std::to_string(numChars);
+
+    // the overlap rule of the VIN characters
+    addBenchmark("resolveConflicts" + suffix, [=](BenchState& state) {
+        auto isOverlapped = [](Detection const& det1, Detection const& det2) {
+            float overlap = cz::computeIou(det1.rect, det2.rect);
+            return overlap > 0.4f || (overlap > 0.3f && std::min(det1.score, det2.score) < 0.2f);
+        };
+        auto compareScore = [](Detection const& lhs, Detection const& rhs) { return lhs.score < rhs.score; };
+
+        std::vector<Detection> dets;
+        while (state.keepRunning()) {
+            state.pauseTiming();
+            dets = *line;
+            state.resumeTiming();
+            cz::resolveConflicts(dets, isOverlapped, compareScore);
+            doNotOptimize(dets.data());
+        }
+    });
+
+    addBenchmark("resolveConflictsSorted" + suffix, [=](BenchState& state) {
+        auto isOverlapped = [](Detection const& det1, Detection const& det2) {
+            float overlap = cz::computeIou(det1.rect, det2.rect);
+            return overlap > 0.4f || (overlap > 0.3f && std::min(det1.score, det2.score) < 0.2f);
+        };
+        auto compareScore = [](Detection const& lhs, Detection const& rhs) { return lhs.score < rhs.score; };
+        auto position = [](Detection const& det) { return cz::xMid(det.rect); };
+        int maxWidth = 0;
+        for (auto const& det : *line) maxWidth = std::max(maxWidth, det.rect.width);
+
+        std::vector<Detection> dets;
+        while (state.keepRunning()) {
+            state.pauseTiming();
+            dets = *line;
+            state.resumeTiming();
+            cz::resolveConflictsSorted(dets, isOverlapped, compareScore, position, maxWidth);
+            doNotOptimize(dets.data());
+        }
+    });
+
+    addBenchmark("eliminateYOutliers" + suffix, [=](BenchState& state) {
+        std::vector<Detection> dets;
+        while (state.keepRunning()) {
+            state.pauseTiming();
+            dets = *line;
+            state.resumeTiming();
+            cz::eliminateYOutliers(dets);
+            doNotOptimize(dets.data());
+        }
+    });
+
+    auto set = std::make_shared<cz::DetectionSet>(
+            cz::DetectionSet::fromDetections(*line, std::make_shared<cz::LabelTable const>(makeLabelTable())));
+
+    addBenchmark("DetectionSet::computeIous" + suffix, [=](BenchState& state) {
+        std::vector<float> ious(set->size());
+        while (state.keepRunning()) {
+            for (size_t i = 0; i < set->size(); ++i) {
+                set->computeIous(i, ious.data());
+                doNotOptimize(ious.data());
+            }
+        }
+    });
+
+    addBenchmark("DetectionSet::sortByXMid" + suffix, [=](BenchState& state) {
+        cz::DetectionSet dets;
+        while (state.keepRunning()) {
+            state.pauseTiming();
+            dets = *set;
+            state.resumeTiming();
+            dets.sortByXMid();
+            doNotOptimize(dets.size());
+        }
+    });
+
+    addBenchmark("DetectionSet::extent" + suffix, [=](BenchState& state) {
+        while (state.keepRunning()) {
+            cv::Rect extent = set->extent();
+            doNotOptimize(extent);
+        }
+    });
+
+    addBenchmark("DetectionSet::toDetections" + suffix, [=](BenchState& state) {
+        while (state.keepRunning()) {
+            std::vector<Detection> dets = set->toDetections();
+            doNotOptimize(dets.data());
+        }
+    });
+
+    addBenchmark("estimateCharSpacing" + suffix, [=](BenchState& state) {
+        while (state.keepRunning()) {
+            int spacing = cz::estimateCharSpacing(*line);
+            doNotOptimize(spacing);
+        }
+    });
+
+    addBenchmark("summarizeCharLine" + suffix, [=](BenchState& state) {
+        while (state.keepRunning()) {
+            cz::CharLineSummary summary = cz::summarizeCharLine(*line);
+            doNotOptimize(summary);
+        }
+    });
+
+    addBenchmark("findMedian" + suffix, [=](BenchState& state) {
+        std::vector<int> heights;
+        for (auto const& det : *line) heights.push_back(det.rect.height);
+        while (state.keepRunning()) {
+            int median = cz::findMedian(heights);
+            doNotOptimize(median);
+        }
+    });
+
+    addBenchmark("findMedian_projected" + suffix, [=](BenchState& state) {
+        while (state.keepRunning()) {
+            int median = cz::findMedian(*line, [](Detection const& det) { return cz::yMid(det.rect); });
+            doNotOptimize(median);
+        }
+    });
+
+    addBenchmark("LinearFit" + suffix, [=](BenchState& state) {
+        std::vector<double> xCoords, yCoords;
+        for (auto const& det : *line) {
+            xCoords.push_back(cz::xMid(det.rect));
+            yCoords.push_back(cz::yMid(det.rect));
+        }
+        while (state.keepRunning()) {
+            cz::LinearFit lf(xCoords, yCoords);
+            doNotOptimize(lf.slope());
+        }
+    });
+}
+
+void registerFieldRouting() {
+    std::mt19937 rng(7);
+    auto rois = std::make_shared<cz::EnumMap<BenchField, cv::Rect>>(makeFieldRois());
+    auto page = std::make_shared<std::vector<Detection>>(makePageDetections(rng, *rois));
+    auto hashedRois = std::make_shared<cz::EnumHashMap<BenchField, cv::Rect>>(rois->cbegin(), rois->cend());
+
+    addBenchmark("distributeItemsByField", [=](BenchState& state) {
+        auto relevant = [](Detection const& det, cv::Rect const& roi) {
+            return (det.rect & roi).area() > 0.5 * det.rect.area();
+        };
+        while (state.keepRunning()) {
+            auto distributions = cz::distributeItemsByField(*page, *hashedRois, relevant);
+            doNotOptimize(distributions.size());
+        }
+    });
+
+    // a collage of the field ROIs, with character lines detected on each tile
+    auto image = std::make_shared<cv::Mat>(IMG_HEIGHT, IMG_WIDTH, CV_8UC3, cv::Scalar(128, 128, 128));
+    auto collage = std::make_shared<cz::Collage<BenchField>>(*image, *rois, 112, 1056);
+    auto collageDets = std::make_shared<std::vector<Detection>>();
+    std::uniform_int_distribution<int> numChars(17, 40);
+    for (int y = 0; y + 112 <= collage->image().rows; y += 120) {
+        std::vector<Detection> line = makeCharLine(rng, numChars(rng), cv::Point(8, y + 40));
+        collageDets->insert(collageDets->end(), line.cbegin(), line.cend());
+    }
+
+    addBenchmark("Collage::splitDetections", [=](BenchState& state) {
+        while (state.keepRunning()) {
+            auto split = collage->splitDetections(*collageDets);
+            doNotOptimize(split.size());
+        }
+    });
+
+    // the packed collage of four images as the second collage pass builds it
+    std::vector<cv::Mat> images(4, *image);
+    std::vector<cz::EnumMap<BenchField, cv::Rect>> imageRois(4, *rois);
+    auto packed = std::make_shared<cz::Collage<BenchField>>(images, imageRois, 112, 1056);
+    auto packedDets = std::make_shared<std::vector<Detection>>();
+    for (int y = 0; y + 112 <= packed->image().rows; y += 120) {
+        std::vector<Detection> line = makeCharLine(rng, numChars(rng), cv::Point(8, y + 40));
+        packedDets->insert(packedDets->end(), line.cbegin(), line.cend());
+    }
+
+    addBenchmark("Collage::splitDetectionsByImage/4", [=](BenchState& state) {
+        while (state.keepRunning()) {
+            auto split = packed->splitDetectionsByImage(*packedDets);
+            doNotOptimize(split.size());
+        }
+    });
+}
+
+void printUsage(char const* program) {
+    std::cerr << "Usage: " << program << " [--filter substring] [--min_time seconds] [--json path]" << std::endl;
+}
+
+} // end namespace
+
+
+int main(int argc, char* argv[]) {
+    using namespace std;
+
+    string filter, pathJson;
+    double minTimeSec = 0.5;
+    for (int i = 1; i < argc; i += 2) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (arg == "--filter") filter = argv[i + 1];
+        else if (arg == "--min_time") minTimeSec = atof(argv[i + 1]);
+        else if (arg == "--json") pathJson = argv[i + 1];
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    registerDetectionKernels();
+    // 300 stands for the stitched values detected with a low threshold
+    for (int numChars : {17, 40, 300}) {
+        registerCharLineHeuristics(numChars);
+    }
+    registerFieldRouting();
+
+    vector<BenchResult> results;
+    cout << left << setw(36) << "benchmark" << right << setw(14) << "iterations"
+         << setw(14) << "ns/op" << setw(14) << "allocs/op" << "\n";
+    for (auto const& benchmark : registry()) {
+        if (!filter.empty() && benchmark.name.find(filter) == string::npos) continue;
+
+        BenchResult result = runBenchmark(benchmark, minTimeSec);
+        cout << left << setw(36) << result.name << right << setw(14) << result.numIterations
+             << fixed << setprecision(1) << setw(14) << result.nsPerOp
+             << setprecision(2) << setw(14) << result.allocationsPerOp << endl;
+        results.push_back(result);
+    }
+
+    if (!pathJson.empty()) {
+        std::ofstream json(pathJson);
+        json << "{\"min_time_sec\": " << minTimeSec << ", \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            json << (i == 0 ? "" : ", ")
+                 << "{\"name\": \"" << results[i].name << "\""
+                 << ", \"iterations\": " << results[i].numIterations
+                 << ", \"ns_per_op\": " << results[i].nsPerOp
+                 << ", \"allocs_per_op\": " << results[i].allocationsPerOp << "}";
+        }
+        json << "]}\n";
+    }
+
+    return 0;
+}
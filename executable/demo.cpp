@@ -2,24 +2,31 @@
 // Created by Zhihao Liu on 18-3-21.
 //
 
-#include <fstream>
+// usage: demo [<image_dir> | --list <path_list> | --stdin]
+// the images are decoded ahead of the OCR on background threads, paths are read one per line from a list or stdin
+
 #include <chrono>
+#include <iostream>
+#include <memory>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
-#include <boost/filesystem.hpp>
 #include "detector.h"
 #include "classifier.h"
 #include "ocr_interface.h"
 #include "ocr_aux/detection_proc.h"
+#include "data_utils/image_source.h"
 
 
 int main(int argc, char* argv[]) {
     using namespace std;
     using namespace cv;
     using namespace cz;
-    using namespace boost::filesystem;
 
     string pathInputDir = "/home/cuizhou/lzh/data/raw-alfaromeo";
+    PathReader readPath;
+    if (argc >= 3 && string(argv[1]) == "--list") readPath = readPathList(argv[2]);
+    else if (argc >= 2 && string(argv[1]) == "--stdin") readPath = readPathStream(cin);
+    else readPath = readDirectory(argc >= 2 ? argv[1] : pathInputDir);
 
     string dirPvaKeys = "/home/cuizhou/lzh/models/models_alfaromeo/pva_keys_compressed/";
     string ptPvaKeys = dirPvaKeys + "test.prototxt";
@@ -63,17 +70,15 @@ int main(int argc, char* argv[]) {
     auto start = std::chrono::system_clock::now();
     int countAll = 0, countCorrect = 0;
 
-    for (directory_iterator itr(pathInputDir); itr != directory_iterator(); ++itr) {
-        string pathImg = itr->path().string();
-        string fileName = itr->path().filename().string();
-        string imgId = fileName.substr(0, fileName.length() - 4);
-
-        cout << "Processing " << imgId << "..." << endl;
+    // decoded at a reduced scale close to the size the OCR processes, while the OCR works on the previous images
+    ImageSource source(readPath, 2, 8, ocr.standardSize());
+    SourceImage item;
 
-        Mat img = imread(pathImg);
-        if (img.empty()) continue;
+    while (source.take(item)) {
+        cout << "Processing " << item.path << "..." << endl;
+        if (item.image.empty()) continue;
 
-        ocr.setImageSource(img);
+        ocr.setImageSource(item.image);
         ocr.processImage();
         cout << ocr.getResultAsString() << endl;
 
@@ -84,7 +89,13 @@ int main(int argc, char* argv[]) {
 
     auto end = std::chrono::system_clock::now();
 
-    cout << "Time elapsed: " << (end - start).count() << endl;
+    cout << "Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << endl;
+
+    ImageSourceStats stats = source.stats();
+    cout << "Decoded: " << stats.numDecoded << ", failed: " << stats.numFailed
+         << ", decode time: " << stats.decodeMs << " ms" << endl;
+    cout << "Queue depth: mean " << stats.meanQueueDepth() << ", max " << stats.maxQueueDepth
+         << "; starved: " << stats.numStarved << " times, " << stats.starvedMs << " ms" << endl;
 
     return 0;
 }
\ No newline at end of file
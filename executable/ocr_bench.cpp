@@ -0,0 +1,349 @@
+// headless throughput benchmark of the Alfa Romeo nameplate OCR
+//
+// usage: ocr_bench <config.ini> <image_dir> [--warmup N] [--iterations N] [--workers N] [--text_band_crop 0|1] [--json path]
+//
+// the config names the models, every section takes prototxt, caffemodel and classes, [chars] also takes mean:
+//   [compute]  mode = cpu | gpu, device = 0
+//   [keys]     key detector
+//   [vin]      VIN character detector
+//   [stitched] character detector for the stitched values
+//   [chars]    character classifier
+//
+// an optional [mock] section runs the pipeline without networks, only the classes of the models are needed then:
+//   [mock]     mode = replay | record, fixture = path, latency_ms = 0, busy_wait = false
+// replay answers from the fixture and synthesizes outputs for unknown inputs, record runs the networks and fills the fixture
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <sys/resource.h>
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include "detector.h"
+#include "classifier.h"
+#include "ocr_interface.h"
+#include "ocr_aux/detection_proc.h"
+
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    int numWarmup = 5;
+    int numIterations = 100;
+    int numWorkers = 1;
+    bool textBandCrop = false;
+    std::string pathJson;
+};
+
+// the models and the OCR of one worker, caffe nets must not be shared across threads
+struct ModelSet {
+    cz::Detector detectorKeys;
+    cz::Detector detectorValueVin;
+    cz::Detector detectorValueOther;
+    cz::Classifier classifierChars;
+    std::unique_ptr<cz::OcrInterface> ocr;
+
+    explicit ModelSet(boost::property_tree::ptree const& config) {
+        std::string mode = config.get<std::string>("compute.mode", "cpu");
+        int device = config.get<int>("compute.device", 0);
+
+        std::string mockMode = config.get<std::string>("mock.mode", "");
+        if (mockMode == "replay") {
+            initMocks(config);
+            return;
+        }
+
+        initDetector(detectorKeys, config.get_child("keys"), mode, device);
+        initDetector(detectorValueVin, config.get_child("vin"), mode, device);
+        initDetector(detectorValueOther, config.get_child("stitched"), mode, device);
+
+        auto const& chars = config.get_child("chars");
+        classifierChars.init(chars.get<std::string>("prototxt"), chars.get<std::string>("caffemodel"),
+                             chars.get<std::string>("mean"), cz::readClassNames(chars.get<std::string>("classes")));
+        // the classifier sets its own mode on init, the detectors' mode is restored for this thread
+        detectorKeys.setComputeMode(mode, device);
+
+        if (mockMode == "record") {
+            std::string fixturePath = config.get<std::string>("mock.fixture");
+            for (cz::Detector* detector : {&detectorKeys, &detectorValueVin, &detectorValueOther}) {
+                detector->recordTo(fixturePath);
+            }
+            classifierChars.recordTo(fixturePath);
+        }
+
+        createOcr();
+    }
+
+    void initMocks(boost::property_tree::ptree const& config) {
+        cz::MockOptions options;
+        options.fixturePath = config.get<std::string>("mock.fixture", "");
+        options.latencyMs = config.get<double>("mock.latency_ms", 0);
+        options.busyWait = config.get<bool>("mock.busy_wait", false);
+
+        detectorKeys.initMock(cz::readClassNames(config.get<std::string>("keys.classes"), true), options);
+        detectorValueVin.initMock(cz::readClassNames(config.get<std::string>("vin.classes"), true), options);
+        detectorValueOther.initMock(cz::readClassNames(config.get<std::string>("stitched.classes"), true), options);
+        classifierChars.initMock(cz::readClassNames(config.get<std::string>("chars.classes")), options);
+
+        createOcr();
+    }
+
+    void createOcr() {
+        ocr.reset(new cz::OcrInterface(cz::OcrType::NAMEPLATE_ALFAROMEO,
+                                       {detectorKeys, detectorValueVin, detectorValueOther, classifierChars}));
+        ocr->setStageStatsEnabled(true);
+    }
+
+    static void initDetector(cz::Detector& detector, boost::property_tree::ptree const& section,
+                             std::string const& mode, int device) {
+        detector.init(section.get<std::string>("prototxt"), section.get<std::string>("caffemodel"),
+                      cz::readClassNames(section.get<std::string>("classes"), true));
+        detector.setComputeMode(mode, device);
+    }
+};
+
+struct WorkerResult {
+    std::vector<double> latenciesMs;
+    std::array<cz::StageStats::Totals, cz::NUM_PROCESS_STAGES> stages;
+    long numForwards = 0;
+    long numFailed = 0; // images that threw while being imported or processed, kept out of the latencies and stages
+    std::string error;
+};
+
+// counts down once per worker, so that timing starts only after every worker has loaded its models and warmed up
+class StartGate {
+public:
+    explicit StartGate(int numWorkers) : numPending_(numWorkers) {}
+
+    void arriveAndWait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (--numPending_ == 0) {
+            start_ = Clock::now();
+            cv_.notify_all();
+        } else {
+            cv_.wait(lock, [this] { return numPending_ == 0; });
+        }
+    }
+
+    Clock::time_point start() const {
+        return start_;
+    }
+
+private:
+    int numPending_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    Clock::time_point start_;
+};
+
+void addTotals(cz::StageStats::Totals const& totals, cz::StageStats::Totals& sum) {
+    sum.numEvents += totals.numEvents;
+    sum.wallMs += totals.wallMs;
+    sum.cpuMs += totals.cpuMs;
+    sum.numForwards += totals.numForwards;
+    sum.numInputPixels += totals.numInputPixels;
+    sum.numDetections += totals.numDetections;
+}
+
+double inputPixelsPerForward(cz::StageStats::Totals const& totals) {
+    return totals.numForwards > 0 ? static_cast<double>(totals.numInputPixels) / totals.numForwards : 0;
+}
+
+void accumulate(cz::StageStats const& stats, WorkerResult& result) {
+    for (int i = 0; i < cz::NUM_PROCESS_STAGES; ++i) {
+        addTotals(stats[static_cast<cz::ProcessStage>(i)], result.stages[i]);
+    }
+    result.numForwards += stats.total().numForwards;
+}
+
+void runWorker(boost::property_tree::ptree const& config, std::vector<std::vector<uint8_t>> const& images,
+               BenchOptions const& options, std::atomic<int>& nextIteration, StartGate& gate, WorkerResult& result) {
+    std::unique_ptr<ModelSet> models;
+    try {
+        models.reset(new ModelSet(config));
+        models->ocr->setTextBandCropEnabled(options.textBandCrop);
+        for (int i = 0; i < options.numWarmup; ++i) {
+            auto const& bytes = images[i % images.size()];
+            models->ocr->importEncoded(bytes.data(), bytes.size());
+            models->ocr->processImage();
+        }
+    } catch (std::exception const& ex) {
+        result.error = ex.what();
+        gate.arriveAndWait();
+        return;
+    }
+    gate.arriveAndWait();
+
+    for (int i = nextIteration++; i < options.numIterations; i = nextIteration++) {
+        auto const& bytes = images[i % images.size()];
+
+        auto start = Clock::now();
+        try {
+            models->ocr->importEncoded(bytes.data(), bytes.size());
+            models->ocr->processImage();
+        } catch (std::exception const&) {
+            // a photo the pipeline fails on must not take the other workers down with it
+            ++result.numFailed;
+            continue;
+        }
+        result.latenciesMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+        accumulate(models->ocr->stageStats(), result);
+    }
+}
+
+double percentile(std::vector<double> const& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+long peakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on Linux
+}
+
+void printUsage(char const* program) {
+    std::cerr << "Usage: " << program << " <config.ini> <image_dir> [--warmup N] [--iterations N] [--workers N] [--text_band_crop 0|1] [--json path]" << std::endl;
+}
+
+} // end namespace
+
+
+int main(int argc, char* argv[]) {
+    using namespace std;
+    using namespace cz;
+    using namespace boost::filesystem;
+
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    BenchOptions options;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "--warmup") options.numWarmup = atoi(argv[i + 1]);
+        else if (arg == "--iterations") options.numIterations = atoi(argv[i + 1]);
+        else if (arg == "--workers") options.numWorkers = max(1, atoi(argv[i + 1]));
+        else if (arg == "--text_band_crop") options.textBandCrop = atoi(argv[i + 1]) != 0;
+        else if (arg == "--json") options.pathJson = argv[i + 1];
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    boost::property_tree::ptree config;
+    boost::property_tree::read_ini(argv[1], config);
+
+    // images are read into memory beforehand, so that disk access is not measured while decoding is
+    vector<vector<uint8_t>> images;
+    for (directory_iterator itr(argv[2]); itr != directory_iterator(); ++itr) {
+        if (!is_regular_file(itr->path())) continue;
+        std::ifstream file(itr->path().string(), ios::binary);
+        vector<uint8_t> bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (!bytes.empty()) images.push_back(move(bytes));
+    }
+    if (images.empty()) {
+        cerr << "No images found in " << argv[2] << endl;
+        return 1;
+    }
+
+    atomic<int> nextIteration(0);
+    StartGate gate(options.numWorkers);
+    vector<WorkerResult> workerResults(options.numWorkers);
+    vector<thread> workers;
+    for (int i = 0; i < options.numWorkers; ++i) {
+        workers.emplace_back(runWorker, cref(config), cref(images), cref(options),
+                             ref(nextIteration), ref(gate), ref(workerResults[i]));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsedSec = chrono::duration<double>(Clock::now() - gate.start()).count();
+
+    WorkerResult total;
+    for (auto const& result : workerResults) {
+        if (!result.error.empty()) {
+            cerr << "Worker failed: " << result.error << endl;
+            return 1;
+        }
+        total.latenciesMs.insert(total.latenciesMs.end(), result.latenciesMs.cbegin(), result.latenciesMs.cend());
+        total.numForwards += result.numForwards;
+        total.numFailed += result.numFailed;
+        for (int i = 0; i < NUM_PROCESS_STAGES; ++i) {
+            addTotals(result.stages[i], total.stages[i]);
+        }
+    }
+
+    vector<double>& latencies = total.latenciesMs;
+    sort(latencies.begin(), latencies.end());
+    double numImages = latencies.size();
+    if (numImages == 0) {
+        cerr << "No image was processed." << endl;
+        return 1;
+    }
+
+    double imagesPerSec = numImages / elapsedSec;
+    double p50 = percentile(latencies, 0.5), p90 = percentile(latencies, 0.9), p99 = percentile(latencies, 0.99);
+    double forwardsPerImage = total.numForwards / numImages;
+    double stagesWallMs = 0;
+    for (auto const& stage : total.stages) stagesWallMs += stage.wallMs;
+
+    cout << fixed << setprecision(2)
+         << "images: " << static_cast<long>(numImages) << ", failed: " << total.numFailed << ", workers: " << options.numWorkers
+         << ", elapsed: " << elapsedSec << " s\n"
+         << "throughput: " << imagesPerSec << " images/s\n"
+         << "latency: p50 " << p50 << " ms, p90 " << p90 << " ms, p99 " << p99 << " ms\n"
+         << "peak RSS: " << peakRssKb() / 1024.0 << " MB\n"
+         << "forwards per image: " << forwardsPerImage << "\n\n"
+         << left << setw(18) << "stage" << right << setw(14) << "ms / image" << setw(14) << "cpu ms / image"
+         << setw(8) << "%" << setw(18) << "forwards / image" << setw(20) << "detections / image"
+         << setw(20) << "pixels / forward" << "\n";
+    for (int i = 0; i < NUM_PROCESS_STAGES; ++i) {
+        StageStats::Totals const& stage = total.stages[i];
+        cout << left << setw(18) << stageName(static_cast<ProcessStage>(i)) << right
+             << setw(14) << stage.wallMs / numImages << setw(14) << stage.cpuMs / numImages
+             << setw(8) << (stagesWallMs > 0 ? 100 * stage.wallMs / stagesWallMs : 0)
+             << setw(18) << stage.numForwards / numImages << setw(20) << stage.numDetections / numImages
+             << setw(20) << inputPixelsPerForward(stage) << "\n";
+    }
+    cout << flush;
+
+    if (!options.pathJson.empty()) {
+        std::ofstream fileJson(options.pathJson);
+        fileJson << "{\"images\": " << static_cast<long>(numImages) << ", \"failed\": " << total.numFailed
+                 << ", \"workers\": " << options.numWorkers
+                 << ", \"elapsed_s\": " << elapsedSec << ", \"images_per_s\": " << imagesPerSec
+                 << ", \"latency_ms\": {\"p50\": " << p50 << ", \"p90\": " << p90 << ", \"p99\": " << p99 << "}"
+                 << ", \"peak_rss_kb\": " << peakRssKb() << ", \"forwards_per_image\": " << forwardsPerImage
+                 << ", \"stages\": {";
+        for (int i = 0; i < NUM_PROCESS_STAGES; ++i) {
+            StageStats::Totals const& stage = total.stages[i];
+            fileJson << (i > 0 ? ", " : "") << "\"" << stageName(static_cast<ProcessStage>(i)) << "\": {"
+                     << "\"ms_per_image\": " << stage.wallMs / numImages
+                     << ", \"cpu_ms_per_image\": " << stage.cpuMs / numImages
+                     << ", \"forwards_per_image\": " << stage.numForwards / numImages
+                     << ", \"detections_per_image\": " << stage.numDetections / numImages
+                     << ", \"input_pixels_per_forward\": " << inputPixelsPerForward(stage) << "}";
+        }
+        fileJson << "}}" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "model_profiler.h"
+
+
+namespace {
+
+void printUsage(char const* program) {
+    std::cerr << "Usage: " << program << " <prototxt> <caffemodel> [options]\n"
+              << "  --input <blob>=<n,c,h,w>  reshape an input blob, repeatable (e.g. --input data=1,3,608,800)\n"
+              << "  --image <path>            fill the data blob with an image instead of random values\n"
+              << "  --runs <n>                profiled forwards, 10 by default\n"
+              << "  --warmup <n>              forwards before profiling, 2 by default\n"
+              << "  --json <path>             write the report as JSON as well\n";
+}
+
+std::vector<int> parseShape(std::string const& str) {
+    std::vector<int> shape;
+    std::istringstream strm(str);
+    std::string dim;
+    while (std::getline(strm, dim, ',')) {
+        shape.push_back(std::atoi(dim.c_str()));
+    }
+    return shape;
+}
+
+} // end namespace
+
+
+int main(int argc, char* argv[]) {
+    using namespace std;
+    using namespace cz;
+
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    caffe::Caffe::set_mode(caffe::Caffe::CPU);
+    ModelProfiler profiler(argv[1], argv[2]);
+
+    string pathImage, pathJson;
+    int numRuns = 10, numWarmupRuns = 2;
+    for (int i = 3; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+
+        if (arg == "--input") {
+            size_t pos = value.find('=');
+            if (pos == string::npos) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            profiler.setInputShape(value.substr(0, pos), parseShape(value.substr(pos + 1)));
+        } else if (arg == "--image") {
+            pathImage = value;
+        } else if (arg == "--runs") {
+            numRuns = atoi(value.c_str());
+        } else if (arg == "--warmup") {
+            numWarmupRuns = atoi(value.c_str());
+        } else if (arg == "--json") {
+            pathJson = value;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!pathImage.empty()) {
+        cv::Mat img = cv::imread(pathImage);
+        if (img.empty()) {
+            cerr << "Failed to read " << pathImage << endl;
+            return 1;
+        }
+        profiler.setInputImage(img);
+    }
+
+    profiler.profile(numRuns, numWarmupRuns);
+    profiler.printTable(cout);
+
+    if (!pathJson.empty()) {
+        ofstream fileJson(pathJson);
+        profiler.printJson(fileJson);
+    }
+
+    return 0;
+}
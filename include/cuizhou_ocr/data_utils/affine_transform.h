@@ -0,0 +1,56 @@
+#ifndef CUIZHOU_OCR_AFFINE_TRANSFORM_H
+#define CUIZHOU_OCR_AFFINE_TRANSFORM_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <opencv2/core/core.hpp>
+#include "data_utils/perspective_transform.h"
+
+
+namespace cz {
+
+// preserves parameters for an affine transform for coordinates
+// the transform is performed as x = a * x + b * y + tx, y = c * x + d * y + ty
+// a rect is mapped to the axis-aligned bounding box of its transformed corners, which is exact under rotations
+// merge() and reverse() follow PerspectiveTransform, and scale-offset transforms map rects identically to it
+class AffineTransform {
+public:
+    ~AffineTransform();
+    AffineTransform();
+
+    AffineTransform(double a, double b, double tx, double c, double d, double ty);
+    AffineTransform(PerspectiveTransform const& transform);
+    // from a 2x3 matrix such as the one given by cv::getRotationMatrix2D()
+    explicit AffineTransform(cv::Mat const& matrix);
+
+    // the rotation around center computed by cv::getRotationMatrix2D(), positive angles are counter-clockwise
+    static AffineTransform rotation(cv::Point2d const& center, double angleInDegree);
+    static AffineTransform translation(double offsetX, double offsetY);
+
+    // the 2x3 matrix of type CV_64F accepted by cv::warpAffine()
+    cv::Mat matrix() const;
+
+    cv::Point2d apply(cv::Point2d const& point) const;
+    cv::Point apply(cv::Point const& point) const;
+    cv::Rect apply(cv::Rect const& rect) const;
+    // map rects in a batch, every coordinate is rounded once after the transform
+    // src and dst may be the same array
+    void apply(cv::Rect const* src, cv::Rect* dst, size_t n) const;
+
+    AffineTransform& reverse();
+    AffineTransform reversed() const;
+
+    AffineTransform& merge(AffineTransform const& that);
+    AffineTransform merged(AffineTransform const& that) const;
+
+    friend std::ostream& operator<<(std::ostream& strm, AffineTransform const& obj);
+
+private:
+    double a_ = 1, b_ = 0, tx_ = 0;
+    double c_ = 0, d_ = 1, ty_ = 0;
+};
+
+} // end namespace cz
+
+
+#endif //CUIZHOU_OCR_AFFINE_TRANSFORM_H
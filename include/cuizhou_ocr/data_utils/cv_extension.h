@@ -5,6 +5,8 @@
 #ifndef CUIZHOU_OCR_CV_EXTENSION_H
 #define CUIZHOU_OCR_CV_EXTENSION_H
 
+#include <cstddef>
+#include <cstdint>
 #include <opencv2/core/core.hpp>
 #include "data_utils/perspective_transform.h"
 
@@ -13,7 +15,15 @@ namespace cz {
 
 cv::Mat imgResizeAndFill(cv::Mat const& img, int newWidth, int newHeight, PerspectiveTransform* pForwardTransform = nullptr);
 cv::Mat imgResizeAndFill(cv::Mat const& img, cv::Size const& newSize, PerspectiveTransform* pForwardTransform = nullptr);
+void imgResizeAndFill(cv::Mat const& img, cv::Mat& dst, PerspectiveTransform* pForwardTransform = nullptr);
+cv::Rect letterboxArea(cv::Size const& srcSize, cv::Size const& dstSize, float* pScale = nullptr);
+void fillLetterboxBorders(cv::Mat& dst, cv::Rect const& area);
 cv::Mat imgRotate(cv::Mat const& img, double angleInDegree);
+void imgRotate(cv::Mat const& img, cv::Mat& dst, double angleInDegree);
+
+cv::Size readJpegSize(uint8_t const* data, size_t size);
+int reducedDecodeFlag(cv::Size const& srcSize, cv::Size const& targetSize);
+void imgDecodeForSize(uint8_t const* data, size_t size, cv::Size const& targetSize, cv::Mat& dst);
 
 cv::Rect extent(cv::Mat const& img);
 
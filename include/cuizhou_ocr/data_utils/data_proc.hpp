@@ -8,6 +8,7 @@
 #include <type_traits>
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <numeric>
 #include "enum_hashmap.hpp"
 
@@ -19,6 +20,10 @@ auto findMedian(Container containerCopy) -> typename Container::value_type;
 template<typename Container, typename Func>
 auto findMedian(Container const& container, Func&& toNumber) -> typename std::result_of<Func(typename Container::value_type)>::type;
 
+// the k-th smallest of values[0, n), the values are partially reordered
+template<typename T>
+T selectKth(T* values, size_t n, size_t k);
+
 template<typename Container>
 auto computeMean(Container const& container) -> typename Container::value_type;
 template<typename Container, typename Func>
@@ -26,6 +31,8 @@ auto computeMean(Container const& container, Func&& toNumber) -> typename std::r
 
 template<typename Container, typename ConflictPred, typename Compare>
 void resolveConflicts(Container& container, ConflictPred&& conflict, Compare&& comp);
+template<typename Container, typename ConflictPred, typename Compare, typename Position>
+void resolveConflictsSorted(Container& container, ConflictPred&& conflict, Compare&& comp, Position&& position, double window);
 
 template<typename Container, typename Field, typename RefObj, typename RelevancePred>
 auto distributeItemsByField(Container const& items, EnumHashMap<Field, RefObj> const& refMap, RelevancePred&& relevant) -> EnumHashMap<Field, Container>;
@@ -33,6 +40,8 @@ auto distributeItemsByField(Container const& items, EnumHashMap<Field, RefObj> c
 struct LinearFit {
 public:
     LinearFit(std::vector<double> const& x, std::vector<double> const& y);
+    // fit from the sums of x * x, x, x * y and y over n points
+    LinearFit(double sumXX, double sumX, double sumXY, double sumY, size_t n);
     double slope() const;
     double constant() const;
 
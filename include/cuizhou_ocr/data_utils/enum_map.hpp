@@ -0,0 +1,73 @@
+#ifndef CUIZHOU_OCR_ENUM_MAP_H
+#define CUIZHOU_OCR_ENUM_MAP_H
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+
+namespace cz {
+
+// a map from the values 0 to N - 1 of an enum to T, stored as a dense array with no allocation or hashing
+// keys out of that range are never stored, find() and count() simply do not see them
+// items are visited in the order of their keys, as in std::map
+// the capacity defaults to enumCapacity(Enum()), a constexpr function found next to the enum by ADL
+template<typename Enum, typename T, size_t N = enumCapacity(Enum())>
+class EnumMap {
+    static_assert(std::is_enum<Enum>::value, "Template class 'EnumMap' only supports enum types as keys.");
+
+    template<bool IsConst>
+    class Iterator;
+
+public:
+    using key_type = Enum;
+    using mapped_type = T;
+    using value_type = std::pair<Enum, T>;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    ~EnumMap();
+    EnumMap();
+    EnumMap(std::initializer_list<value_type> items);
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+    void swap(EnumMap& other);
+
+    T& operator[](Enum key);
+    T const& at(Enum key) const; // throws std::out_of_range if absent
+    size_t count(Enum key) const;
+    iterator find(Enum key);
+    const_iterator find(Enum key) const;
+
+    // as std::map, an existing item is kept
+    std::pair<iterator, bool> emplace(Enum key, T value);
+    size_t erase(Enum key);
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+private:
+    std::array<value_type, N> items_;
+    std::array<bool, N> present_;
+    size_t size_ = 0;
+
+    static bool inRange(Enum key);
+    static size_t indexOf(Enum key);
+    size_t nextPresent(size_t idx) const;
+};
+
+} // end namespace cz
+
+
+#include "./impl/enum_map.impl.hpp"
+
+#endif //CUIZHOU_OCR_ENUM_MAP_H
@@ -0,0 +1,93 @@
+#ifndef CUIZHOU_OCR_IMAGE_SOURCE_H
+#define CUIZHOU_OCR_IMAGE_SOURCE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+namespace cz {
+
+// gives the next path to be decoded, false if there are no more
+using PathReader = std::function<bool(std::string& path)>;
+
+// the regular files of a directory in the order of their names
+PathReader readDirectory(std::string const& dirPath);
+// one path per line, empty lines are skipped
+PathReader readPathList(std::string const& listPath);
+// same as above from a stream such as std::cin, which must outlive the reader
+PathReader readPathStream(std::istream& strm);
+
+struct SourceImage {
+    long index = -1; // position of the path in the input, images are taken in the order they finish decoding
+    std::string path;
+    cv::Mat image; // empty if the file could not be read or decoded
+    double decodeMs = 0; // reading the file included
+};
+
+struct ImageSourceStats {
+    long numDecoded = 0;
+    long numFailed = 0;
+    double decodeMs = 0; // summed over the decode threads
+
+    long numTaken = 0;
+    long sumQueueDepth = 0; // sampled at every take
+    long maxQueueDepth = 0;
+    long numStarved = 0; // takes that found the queue empty and waited for a decode
+    double starvedMs = 0;
+    long numBlocked = 0; // decodes that waited for room in a full queue
+
+    double meanQueueDepth() const;
+};
+
+// decodes images ahead of their consumers on a pool of threads into a bounded queue
+// images are decoded at a reduced scale close to targetSize if it is non-empty, as OcrHandler::importEncoded() does
+class ImageSource {
+public:
+    // stops decoding and waits for the threads, a pending read of a path stream is waited for as well
+    ~ImageSource();
+    ImageSource() = delete;
+
+    ImageSource(PathReader readPath, int numThreads, size_t capacity, cv::Size const& targetSize = cv::Size());
+
+    ImageSource(ImageSource const&) = delete;
+    ImageSource& operator=(ImageSource const&) = delete;
+
+    // blocks until an image is decoded, false once all of them are taken
+    // it may be called from several consumer threads
+    bool take(SourceImage& item);
+
+    ImageSourceStats stats() const;
+
+private:
+    PathReader readPath_;
+    std::mutex pathMutex_; // guards readPath_ and nextIndex_
+    long nextIndex_ = 0;
+
+    cv::Size targetSize_;
+    size_t capacity_;
+
+    mutable std::mutex mutex_; // guards everything below
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<SourceImage> queue_;
+    int numRunning_ = 0; // decode threads that may still push
+    bool stopping_ = false;
+    ImageSourceStats stats_;
+
+    std::vector<std::thread> threads_;
+
+    bool nextPath(SourceImage& item);
+    void run();
+};
+
+} // end namespace cz
+
+#endif //CUIZHOU_OCR_IMAGE_SOURCE_H
@@ -25,6 +25,26 @@ auto findMedian(Container const& container, Func&& toNumber) -> typename std::re
     return numbers.at(numbers.size() / 2);
 };
 
+template<typename T>
+T selectKth(T* values, size_t n, size_t k) {
+    assert(k < n);
+
+    // short inputs are fully sorted by insertion, which beats the partitioning of nth_element on them
+    if (n <= 16) {
+        for (size_t i = 1; i < n; ++i) {
+            T value = values[i];
+            size_t j = i;
+            for (; j > 0 && value < values[j - 1]; --j) {
+                values[j] = values[j - 1];
+            }
+            values[j] = value;
+        }
+    } else {
+        std::nth_element(values, values + k, values + n);
+    }
+    return values[k];
+}
+
 // compute the mean of a collection of numbers
 template<typename Container>
 auto computeMean(Container const& container) -> typename Container::value_type {
@@ -90,6 +110,51 @@ void resolveConflicts(Container& container, ConflictPred&& conflict, Compare&& c
 //    }
 }
 
+// same survivors as resolveConflicts() for a container sorted by position, provided that
+// items whose positions differ by more than window never conflict
+// losers are only marked during the scan, and the container is compacted once at the end
+template<typename Container, typename ConflictPred, typename Compare, typename Position>
+void resolveConflictsSorted(Container& container, ConflictPred&& conflict, Compare&& comp, Position&& position, double window) {
+    size_t n = container.size();
+    if (n < 2) return;
+
+    auto itemAt = [&](size_t idx) -> typename Container::value_type& { return *std::next(container.begin(), idx); };
+
+    std::vector<double> positions(n);
+    for (size_t i = 0; i < n; ++i) {
+        positions[i] = position(itemAt(i));
+        assert(i == 0 || positions[i - 1] <= positions[i]);
+    }
+    std::vector<char> eliminated(n, 0);
+
+    // visit the pairs in the order resolveConflicts() does, skipping those out of the window
+    size_t lo = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (eliminated[i]) continue;
+        while (positions[lo] < positions[i] - window) ++lo;
+
+        for (size_t j = lo; j < n && positions[j] <= positions[i] + window; ++j) {
+            if (j == i || eliminated[j] || !conflict(itemAt(i), itemAt(j))) continue;
+
+            if (comp(itemAt(i), itemAt(j))) {
+                eliminated[i] = 1;
+                break;
+            } else {
+                eliminated[j] = 1;
+            }
+        }
+    }
+
+    auto itrWrite = container.begin();
+    auto itrRead = container.begin();
+    for (size_t i = 0; i < n; ++i, ++itrRead) {
+        if (eliminated[i]) continue;
+        if (itrWrite != itrRead) *itrWrite = std::move(*itrRead);
+        ++itrWrite;
+    }
+    container.erase(itrWrite, container.end());
+}
+
 template<typename Container, typename Field, typename RefObj, typename RelevancePred>
 auto distributeItemsByField(Container const& items, EnumHashMap<Field, RefObj> const& refMap, RelevancePred&& relevant)
 -> EnumHashMap<Field, Container> {
@@ -0,0 +1,197 @@
+#include <cassert>
+#include <stdexcept>
+
+namespace cz {
+
+template<typename Enum, typename T, size_t N>
+template<bool IsConst>
+class EnumMap<Enum, T, N>::Iterator {
+    using Map = typename std::conditional<IsConst, EnumMap const, EnumMap>::type;
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename EnumMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = typename std::conditional<IsConst, value_type const*, value_type*>::type;
+    using reference = typename std::conditional<IsConst, value_type const&, value_type&>::type;
+
+    Iterator() = default;
+    Iterator(Map* map, size_t idx) : map_(map), idx_(idx) {}
+    // a mutable iterator converts to a const one
+    template<bool WasConst, typename = typename std::enable_if<IsConst && !WasConst>::type>
+    Iterator(Iterator<WasConst> const& other) : map_(other.map_), idx_(other.idx_) {}
+
+    reference operator*() const { return map_->items_[idx_]; }
+    pointer operator->() const { return &map_->items_[idx_]; }
+
+    Iterator& operator++() {
+        idx_ = map_->nextPresent(idx_ + 1);
+        return *this;
+    }
+
+    Iterator operator++(int) {
+        Iterator prev = *this;
+        ++*this;
+        return prev;
+    }
+
+    bool operator==(Iterator const& other) const { return idx_ == other.idx_; }
+    bool operator!=(Iterator const& other) const { return idx_ != other.idx_; }
+
+private:
+    template<bool> friend class Iterator;
+
+    Map* map_ = nullptr;
+    size_t idx_ = N;
+};
+
+template<typename Enum, typename T, size_t N>
+EnumMap<Enum, T, N>::~EnumMap() = default;
+
+template<typename Enum, typename T, size_t N>
+EnumMap<Enum, T, N>::EnumMap() {
+    for (size_t i = 0; i < N; ++i) {
+        items_[i].first = static_cast<Enum>(i);
+    }
+    present_.fill(false);
+}
+
+template<typename Enum, typename T, size_t N>
+EnumMap<Enum, T, N>::EnumMap(std::initializer_list<value_type> items) : EnumMap() {
+    for (auto const& item : items) {
+        emplace(item.first, item.second);
+    }
+}
+
+template<typename Enum, typename T, size_t N>
+size_t EnumMap<Enum, T, N>::size() const {
+    return size_;
+}
+
+template<typename Enum, typename T, size_t N>
+bool EnumMap<Enum, T, N>::empty() const {
+    return size_ == 0;
+}
+
+template<typename Enum, typename T, size_t N>
+void EnumMap<Enum, T, N>::clear() {
+    for (size_t i = 0; i < N; ++i) {
+        if (present_[i]) items_[i].second = T();
+    }
+    present_.fill(false);
+    size_ = 0;
+}
+
+template<typename Enum, typename T, size_t N>
+void EnumMap<Enum, T, N>::swap(EnumMap& other) {
+    using std::swap;
+    for (size_t i = 0; i < N; ++i) {
+        if (present_[i] || other.present_[i]) swap(items_[i].second, other.items_[i].second);
+    }
+    swap(present_, other.present_);
+    swap(size_, other.size_);
+}
+
+template<typename Enum, typename T, size_t N>
+T& EnumMap<Enum, T, N>::operator[](Enum key) {
+    assert(inRange(key));
+    size_t idx = indexOf(key);
+    if (!present_[idx]) {
+        present_[idx] = true;
+        ++size_;
+    }
+    return items_[idx].second;
+}
+
+template<typename Enum, typename T, size_t N>
+T const& EnumMap<Enum, T, N>::at(Enum key) const {
+    if (!count(key)) throw std::out_of_range("Key is not in the EnumMap.");
+    return items_[indexOf(key)].second;
+}
+
+template<typename Enum, typename T, size_t N>
+size_t EnumMap<Enum, T, N>::count(Enum key) const {
+    return inRange(key) && present_[indexOf(key)] ? 1 : 0;
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::iterator EnumMap<Enum, T, N>::find(Enum key) {
+    return count(key) ? iterator(this, indexOf(key)) : end();
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::const_iterator EnumMap<Enum, T, N>::find(Enum key) const {
+    return count(key) ? const_iterator(this, indexOf(key)) : end();
+}
+
+template<typename Enum, typename T, size_t N>
+std::pair<typename EnumMap<Enum, T, N>::iterator, bool> EnumMap<Enum, T, N>::emplace(Enum key, T value) {
+    assert(inRange(key));
+    size_t idx = indexOf(key);
+    if (present_[idx]) return std::make_pair(iterator(this, idx), false);
+
+    items_[idx].second = std::move(value);
+    present_[idx] = true;
+    ++size_;
+    return std::make_pair(iterator(this, idx), true);
+}
+
+template<typename Enum, typename T, size_t N>
+size_t EnumMap<Enum, T, N>::erase(Enum key) {
+    if (!count(key)) return 0;
+
+    size_t idx = indexOf(key);
+    items_[idx].second = T();
+    present_[idx] = false;
+    --size_;
+    return 1;
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::iterator EnumMap<Enum, T, N>::begin() {
+    return iterator(this, nextPresent(0));
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::iterator EnumMap<Enum, T, N>::end() {
+    return iterator(this, N);
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::const_iterator EnumMap<Enum, T, N>::begin() const {
+    return const_iterator(this, nextPresent(0));
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::const_iterator EnumMap<Enum, T, N>::end() const {
+    return const_iterator(this, N);
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::const_iterator EnumMap<Enum, T, N>::cbegin() const {
+    return begin();
+}
+
+template<typename Enum, typename T, size_t N>
+typename EnumMap<Enum, T, N>::const_iterator EnumMap<Enum, T, N>::cend() const {
+    return end();
+}
+
+template<typename Enum, typename T, size_t N>
+bool EnumMap<Enum, T, N>::inRange(Enum key) {
+    using Underlying = typename std::underlying_type<Enum>::type;
+    return static_cast<Underlying>(key) >= 0 && static_cast<size_t>(key) < N;
+}
+
+template<typename Enum, typename T, size_t N>
+size_t EnumMap<Enum, T, N>::indexOf(Enum key) {
+    return static_cast<size_t>(key);
+}
+
+template<typename Enum, typename T, size_t N>
+size_t EnumMap<Enum, T, N>::nextPresent(size_t idx) const {
+    while (idx < N && !present_[idx]) ++idx;
+    return idx;
+}
+
+} // end namespace cz
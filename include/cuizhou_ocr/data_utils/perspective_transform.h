@@ -38,6 +38,7 @@ public:
     PerspectiveTransform merged(PerspectiveTransform const& that) const;
 
     friend std::ostream& operator<<(std::ostream& strm, PerspectiveTransform const& obj);
+    friend class AffineTransform;
 
 private:
     double offsetX_ = 0, offsetY_ = 0;
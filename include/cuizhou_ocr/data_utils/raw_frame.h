@@ -0,0 +1,29 @@
+#ifndef CUIZHOU_OCR_RAW_FRAME_H
+#define CUIZHOU_OCR_RAW_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core/core.hpp>
+#include "data_utils/perspective_transform.h"
+
+
+namespace cz {
+
+enum class PixelFormat { BGR = 0, BGRA, GRAY, NV12, YUYV };
+
+// describes a frame in the native pixel format of a capture device, the pixels are not owned
+// for NV12 the interleaved UV plane immediately follows the Y plane with the same stride
+struct RawFrame {
+    uint8_t const* data;
+    int width;
+    int height;
+    size_t stride; // bytes per row
+    PixelFormat format;
+};
+
+void imgFromRawFrame(RawFrame const& frame, cv::Mat& dst);
+void imgResizeAndFill(RawFrame const& frame, cv::Mat& dst, cv::Mat& scratch, PerspectiveTransform* pForwardTransform = nullptr);
+
+} // end namespace cz
+
+#endif //CUIZHOU_OCR_RAW_FRAME_H
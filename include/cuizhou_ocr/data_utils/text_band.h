@@ -0,0 +1,34 @@
+#ifndef CUIZHOU_OCR_TEXT_BAND_H
+#define CUIZHOU_OCR_TEXT_BAND_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+namespace cz {
+
+// the defaults are those the training crops of scripts/cropping_roi are made with
+struct TextBandParams {
+    int numLines = 8; // text lines to be located
+    int lineRadius = 6; // half height of the window the edge energy of a line is summed over
+    double bandRadiusRatio = 1.0 / 6; // half height of the band relative to the height of the image
+};
+
+struct TextBand {
+    cv::Rect rect; // spans the whole width of the image, empty if the image has no edges
+    double confidence = 0; // the share of the edge energy of the image that falls within the band
+};
+
+// locate the horizontal band holding the text of a nameplate with classical edge statistics
+// the rows of strongest Canny edge energy are taken as text lines one after another, and the band is centered on their median
+TextBand locateTextBand(cv::Mat const& img, TextBandParams const& params = TextBandParams());
+// same as above on the edge energy of each row of an image
+// each line is searched in O(rows) on a prefix sum of the energy
+TextBand locateTextBand(std::vector<int> const& rowEnergy, int width, TextBandParams const& params = TextBandParams());
+
+// the Canny edge energy of each row of an 8-bit BGR or grayscale image
+void computeRowEdgeEnergy(cv::Mat const& img, std::vector<int>& rowEnergy);
+
+} // end namespace cz
+
+#endif //CUIZHOU_OCR_TEXT_BAND_H
@@ -10,7 +10,7 @@
 #include <vector>
 #include <unordered_map>
 #include <cassert>
-#include "data_utils/enum_hashmap.hpp"
+#include "data_utils/enum_map.hpp"
 
 
 namespace cz {
@@ -28,13 +28,15 @@ public:
                   std::vector<std::string> const& aliases = std::vector<std::string>(), std::string fallbackAlias = "");
 
     EnumClass toEnum(std::string const& name) const;
+    // the enum of each label of a model, looked up once so that detections can be mapped by class index
+    std::vector<EnumClass> indexLabels(std::vector<std::string> const& labels) const;
     std::string getName(EnumClass enumItem) const;
     std::string getAlias(EnumClass enumItem) const;
 
 private:
-    std::unordered_map<EnumClass, std::string, EnumHasher<EnumClass>> enumToName_;
+    EnumMap<EnumClass, std::string> enumToName_;
     std::unordered_map<std::string, EnumClass> nameToEnum_;
-    std::unordered_map<EnumClass, std::string, EnumHasher<EnumClass>> enumToAlias_;
+    EnumMap<EnumClass, std::string> enumToAlias_;
 
     EnumClass const fallbackEnum_;
     std::string const fallbackName_;
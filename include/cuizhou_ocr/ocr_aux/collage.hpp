@@ -5,9 +5,13 @@
 #ifndef CUIZHOU_OCR_COLLAGE_H
 #define CUIZHOU_OCR_COLLAGE_H
 
+#include <algorithm>
+#include <vector>
 #include <opencv2/core/core.hpp>
-#include "data_utils/enum_hashmap.hpp"
-#include "data_utils/perspective_transform.h"
+#include "data_utils/affine_transform.h"
+#include "data_utils/enum_map.hpp"
+#include "detection_set.h"
+#include "ocr_aux/tile_grid.h"
 
 namespace cz {
 
@@ -15,12 +19,21 @@ template<typename FieldEnum>
 class Collage {
 private:
     struct RoiTransformInfo {
+        int imageIdx;
+        FieldEnum field;
         cv::Rect roi;
-        PerspectiveTransform backwardTransform;
+        AffineTransform backwardTransform;
 
         ~RoiTransformInfo();
         RoiTransformInfo();
-        RoiTransformInfo(cv::Rect const& _roi, PerspectiveTransform const& _backwardTransform);
+        RoiTransformInfo(int _imageIdx, FieldEnum _field, cv::Rect const& _roi, AffineTransform const& _backwardTransform);
+    };
+
+    struct RoiPlacement {
+        int imageIdx;
+        FieldEnum field;
+        cv::Rect originRoi;
+        cv::Rect targetRoi;
     };
 
 public:
@@ -28,17 +41,60 @@ public:
     Collage();
 
     Collage(cv::Mat const& image,
-            EnumHashMap<FieldEnum, std::pair<cv::Rect, cv::Rect>> const& roiMapping,
+            EnumMap<FieldEnum, std::pair<cv::Rect, cv::Rect>> const& roiMapping,
             cv::Size const& resultSize);
 
+    // pack the origin ROIs into shelves of a canvas no wider than maxWidth
+    // each ROI is scaled so that its height equals tileHeight
+    Collage(cv::Mat const& image,
+            EnumMap<FieldEnum, cv::Rect> const& originRois,
+            int tileHeight, int maxWidth, int tileSpacing = 8);
+
+    // pack the ROIs of several images into one canvas, each tile is keyed by (image index, field)
+    Collage(std::vector<cv::Mat> const& images,
+            std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois,
+            int tileHeight, int maxWidth, int tileSpacing = 8);
+
+    // same as above, but the collage is drawn into the top-left corner of a canvas owned by the caller
+    // the canvas is only reallocated when it is too small, and must outlive the use of image()
+    Collage(std::vector<cv::Mat> const& images,
+            std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois,
+            int tileHeight, int maxWidth, cv::Mat& canvas, int tileSpacing = 8);
+
+    // same as above, but each ROI is scaled as it would be letterboxed into the slot of its field
+    // so that the characters keep the size they have in a fixed layout of those slots, fields without a slot are skipped
+    // tiles of different heights are packed first-fit decreasing by height
+    Collage(std::vector<cv::Mat> const& images,
+            std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois,
+            EnumMap<FieldEnum, cv::Size> const& slotSizes, int maxWidth, cv::Mat& canvas, int tileSpacing = 8);
+
     cv::Mat const& image() const;
+    double fillRatio() const;
+    bool empty() const;
 
-    EnumHashMap<FieldEnum, std::vector<Detection>>
+    EnumMap<FieldEnum, std::vector<Detection>>
     splitDetections(std::vector<Detection> const& dets, float overlapThresh = 0.5);
 
+    // the i-th item holds the detections routed back to the i-th source image
+    std::vector<EnumMap<FieldEnum, std::vector<Detection>>>
+    splitDetectionsByImage(std::vector<Detection> const& dets, float overlapThresh = 0.5);
+    std::vector<EnumMap<FieldEnum, DetectionSet>>
+    splitDetectionsByImage(DetectionSet const& dets, float overlapThresh = 0.5);
+
 private:
+    static int const SIZE_MULTIPLE_OF = 32;
+
     cv::Mat resultImage_;
-    EnumHashMap<FieldEnum, RoiTransformInfo> roiTransformInfos;
+    std::vector<RoiTransformInfo> roiTransformInfos;
+    TileGrid tileGrid_; // over the target ROIs of roiTransformInfos
+    int numImages_ = 0;
+    double fillRatio_ = 0;
+
+    static std::vector<RoiPlacement> scaleToHeight(std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois,
+                                                   int tileHeight, int maxWidth);
+    void pack(std::vector<cv::Mat> const& images, std::vector<RoiPlacement>& placements,
+              int maxWidth, int tileSpacing, cv::Mat& canvas);
+    void fillTargetRois(std::vector<cv::Mat> const& images, std::vector<RoiPlacement> const& placements);
 };
 
 } // end namespace cz
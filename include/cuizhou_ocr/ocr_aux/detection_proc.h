@@ -8,28 +8,61 @@
 #include <vector>
 #include <string>
 #include "detection.h"
+#include "detection_set.h"
 #include "ocr_detection.h"
 
 
 namespace cz {
 
+// the geometry of a line of characters
+struct CharLineSummary {
+    int numChars = 0;
+    double slope = 0; // of the least-squares line through the centers
+    int spacing = 0; // median distance between the x-mids of neighbours, meaningful if sorted by x-mid
+    int height = 0; // median height
+    int yMid = 0; // median y-mid
+};
+
+// the classes of a label table the character heuristics look at, so that they compare class ids rather than labels
+// the id of a label missing from the table is -1
+struct CharClasses {
+    std::vector<char> isNumeric; // by class id
+    int one = -1;
+    int four = -1;
+    int seven = -1;
+    int letterH = -1;
+};
+
 std::vector<std::string> readClassNames(std::string const& path, bool addBackground = false);
 bool isNumbericChar(std::string const& str);
+CharClasses resolveCharClasses(LabelTable const& labels);
 
 void sortByXMid(std::vector<Detection>& dets);
 void sortByYMid(std::vector<Detection>& dets);
 void sortByScoreDescending(std::vector<Detection>& dets);
 bool isSortedByXMid(std::vector<Detection> const& dets);
+bool isSortedByXMid(DetectionSet const& dets);
 
 OcrDetection joinDetections(std::vector<Detection> const& dets);
 std::string joinDetectedChars(std::vector<Detection> const& dets);
+OcrDetection joinDetections(DetectionSet const& dets);
+std::string joinDetectedChars(DetectionSet const& dets);
 
 void eliminateYOutliers(std::vector<Detection>& dets, float thresh = 0.25);
 void eliminateLetters(std::vector<Detection>& dets);
+void eliminateYOutliers(DetectionSet& dets, float thresh = 0.25);
+void eliminateLetters(DetectionSet& dets, CharClasses const& chars);
+
+// computed in one pass, without allocating for lines of up to 64 characters
+// the medians are those of findMedian(), the slope that of LinearFit
+CharLineSummary summarizeCharLine(std::vector<Detection> const& dets);
+CharLineSummary summarizeCharLine(DetectionSet const& dets);
 
 cv::Rect computeExtent(std::vector<Detection> const& dets);
 double estimateCharAlignmentSlope(std::vector<Detection> const& dets);
 int estimateCharSpacing(std::vector<Detection> const& dets);
+double estimateCharAlignmentSlope(DetectionSet const& dets);
+int estimateCharSpacing(DetectionSet const& dets);
 
 void shrinkRectToExtent(cv::Rect& rect, cv::Rect const& extentInRect);
 void expandRect(cv::Rect& rect, int xBorder, int yBorder);
@@ -28,6 +28,16 @@ EnumClass ClassnameDict<EnumClass>::toEnum(std::string const& name) const {
     return itr == nameToEnum_.end() ? fallbackEnum_ : itr->second;
 }
 
+template<typename EnumClass>
+std::vector<EnumClass> ClassnameDict<EnumClass>::indexLabels(std::vector<std::string> const& labels) const {
+    std::vector<EnumClass> enums;
+    enums.reserve(labels.size());
+    for (auto const& label : labels) {
+        enums.push_back(toEnum(label));
+    }
+    return enums;
+}
+
 template<typename EnumClass>
 std::string ClassnameDict<EnumClass>::getName(EnumClass enumItem) const {
     auto itr = enumToName_.find(enumItem);
@@ -1,6 +1,7 @@
 #include "data_utils/cv_extension.h"
 #include "data_utils/data_proc.hpp"
 #include "ocr_aux/detection_proc.h"
+#include "tracing.h"
 
 namespace cz {
 
@@ -11,8 +12,9 @@ template <typename FieldEnum>
 Collage<FieldEnum>::RoiTransformInfo::RoiTransformInfo() = default;
 
 template <typename FieldEnum>
-Collage<FieldEnum>::RoiTransformInfo::RoiTransformInfo(cv::Rect const& _roi, PerspectiveTransform const& _backwardTransform)
-        : roi(_roi), backwardTransform(_backwardTransform) {};
+Collage<FieldEnum>::RoiTransformInfo::RoiTransformInfo(int _imageIdx, FieldEnum _field,
+                                                       cv::Rect const& _roi, AffineTransform const& _backwardTransform)
+        : imageIdx(_imageIdx), field(_field), roi(_roi), backwardTransform(_backwardTransform) {};
 
 template<typename FieldEnum>
 Collage<FieldEnum>::~Collage() = default;
@@ -25,47 +27,273 @@ cv::Mat const& Collage<FieldEnum>::image() const {
     return resultImage_;
 }
 
+template<typename FieldEnum>
+double Collage<FieldEnum>::fillRatio() const {
+    return fillRatio_;
+}
+
+template<typename FieldEnum>
+bool Collage<FieldEnum>::empty() const {
+    return roiTransformInfos.empty();
+}
+
 template<typename FieldEnum>
 Collage<FieldEnum>::Collage(cv::Mat const& image,
-                            EnumHashMap<FieldEnum, std::pair<cv::Rect, cv::Rect>> const& roiMapping,
+                            EnumMap<FieldEnum, std::pair<cv::Rect, cv::Rect>> const& roiMapping,
                             cv::Size const& resultSize) {
-    cv::Mat resultImg(resultSize, CV_8UC3, cv::Scalar(0, 0, 0));
-
+    CZ_TRACE_SCOPE("Collage::Collage");
+    std::vector<RoiPlacement> placements;
     for (auto const& item : roiMapping) {
-        FieldEnum field = item.first;
-        cv::Rect const& originRoi = item.second.first;
-        cv::Rect const& targetRoi = item.second.second;
+        placements.push_back(RoiPlacement{0, item.first, item.second.first, item.second.second});
+    }
+
+    resultImage_ = cv::Mat(resultSize, CV_8UC3, cv::Scalar(0, 0, 0));
+    fillTargetRois(std::vector<cv::Mat>{image}, placements);
+}
+
+template<typename FieldEnum>
+Collage<FieldEnum>::Collage(cv::Mat const& image,
+                            EnumMap<FieldEnum, cv::Rect> const& originRois,
+                            int tileHeight, int maxWidth, int tileSpacing)
+        : Collage(std::vector<cv::Mat>{image}, std::vector<EnumMap<FieldEnum, cv::Rect>>{originRois},
+                  tileHeight, maxWidth, tileSpacing) {}
+
+template<typename FieldEnum>
+Collage<FieldEnum>::Collage(std::vector<cv::Mat> const& images,
+                            std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois,
+                            int tileHeight, int maxWidth, int tileSpacing) {
+    cv::Mat canvas;
+    std::vector<RoiPlacement> placements = scaleToHeight(originRois, tileHeight, maxWidth);
+    pack(images, placements, maxWidth, tileSpacing, canvas);
+}
+
+template<typename FieldEnum>
+Collage<FieldEnum>::Collage(std::vector<cv::Mat> const& images,
+                            std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois,
+                            int tileHeight, int maxWidth, cv::Mat& canvas, int tileSpacing) {
+    std::vector<RoiPlacement> placements = scaleToHeight(originRois, tileHeight, maxWidth);
+    pack(images, placements, maxWidth, tileSpacing, canvas);
+}
+
+template<typename FieldEnum>
+Collage<FieldEnum>::Collage(std::vector<cv::Mat> const& images,
+                            std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois,
+                            EnumMap<FieldEnum, cv::Size> const& slotSizes, int maxWidth, cv::Mat& canvas, int tileSpacing) {
+    std::vector<RoiPlacement> placements;
+    for (int i = 0; i < originRois.size(); ++i) {
+        for (auto const& item : originRois[i]) {
+            cv::Rect const& originRoi = item.second;
+            auto itrSlot = slotSizes.find(item.first);
+            if (originRoi.area() == 0 || itrSlot == slotSizes.end()) continue;
+
+            // the scale imgResizeAndFill() would letterbox the ROI into its slot with
+            cv::Rect area = letterboxArea(originRoi.size(), itrSlot->second);
+            cv::Size tileSize(std::min(std::max(area.width, 1), maxWidth), std::max(area.height, 1));
+            placements.push_back(RoiPlacement{i, item.first, originRoi, cv::Rect(cv::Point(0, 0), tileSize)});
+        }
+    }
+    pack(images, placements, maxWidth, tileSpacing, canvas);
+}
+
+template<typename FieldEnum>
+std::vector<typename Collage<FieldEnum>::RoiPlacement>
+Collage<FieldEnum>::scaleToHeight(std::vector<EnumMap<FieldEnum, cv::Rect>> const& originRois, int tileHeight, int maxWidth) {
+    std::vector<RoiPlacement> placements;
+    for (int i = 0; i < originRois.size(); ++i) {
+        for (auto const& item : originRois[i]) {
+            cv::Rect const& originRoi = item.second;
+            if (originRoi.area() == 0) continue;
+
+            double scale = static_cast<double>(tileHeight) / originRoi.height;
+            int tileWidth = std::min(static_cast<int>(std::round(originRoi.width * scale)), maxWidth);
+            placements.push_back(RoiPlacement{i, item.first, originRoi, cv::Rect(0, 0, std::max(tileWidth, 1), tileHeight)});
+        }
+    }
+    return placements;
+}
+
+template<typename FieldEnum>
+void Collage<FieldEnum>::pack(std::vector<cv::Mat> const& images, std::vector<RoiPlacement>& placements,
+                              int maxWidth, int tileSpacing, cv::Mat& canvas) {
+    CZ_TRACE_SCOPE("Collage::Collage");
+    assert(std::all_of(placements.begin(), placements.end(),
+                       [&images](RoiPlacement const& placement) { return placement.imageIdx < images.size(); }));
+
+    // first-fit decreasing on shelves, each as high as its first tile
+    // ties are broken by the keys so that the layout does not depend on the iteration order of the maps
+    std::sort(placements.begin(), placements.end(), [](RoiPlacement const& lhs, RoiPlacement const& rhs) {
+        if (lhs.targetRoi.height != rhs.targetRoi.height) return lhs.targetRoi.height > rhs.targetRoi.height;
+        if (lhs.targetRoi.width != rhs.targetRoi.width) return lhs.targetRoi.width > rhs.targetRoi.width;
+        return lhs.imageIdx != rhs.imageIdx ? lhs.imageIdx < rhs.imageIdx : lhs.field < rhs.field;
+    });
+
+    std::vector<cv::Rect> shelves; // the width of a shelf is the right end of its last tile
+    std::vector<int> shelfOfPlacement;
+    int canvasWidth = 0;
+
+    for (auto& placement : placements) {
+        cv::Rect& targetRoi = placement.targetRoi;
+
+        int shelf = 0;
+        while (shelf < shelves.size() && shelves[shelf].width + tileSpacing + targetRoi.width > maxWidth) ++shelf;
+        if (shelf == shelves.size()) {
+            int shelfY = shelves.empty() ? 0 : shelves.back().br().y + tileSpacing;
+            shelves.emplace_back(0, shelfY, -tileSpacing, targetRoi.height);
+        }
+
+        targetRoi.x = shelves[shelf].width + tileSpacing;
+        targetRoi.y = shelves[shelf].y;
+        shelves[shelf].width = targetRoi.br().x;
+        shelfOfPlacement.push_back(shelf);
+
+        canvasWidth = std::max(canvasWidth, targetRoi.br().x);
+    }
+
+    int canvasHeight = shelves.empty() ? 0 : shelves.back().br().y;
+    auto roundUp = [](int length) { return (length + SIZE_MULTIPLE_OF - 1) / SIZE_MULTIPLE_OF * SIZE_MULTIPLE_OF; };
+    cv::Size resultSize(roundUp(std::max(canvasWidth, 1)), roundUp(std::max(canvasHeight, 1)));
+
+    if (canvas.type() != CV_8UC3 || canvas.cols < resultSize.width || canvas.rows < resultSize.height) {
+        canvas.create(std::max(canvas.rows, resultSize.height), std::max(canvas.cols, resultSize.width), CV_8UC3);
+    }
+    resultImage_ = canvas(cv::Rect(cv::Point(0, 0), resultSize));
+
+    // tiles overwrite their own area, so only the spacings between them, the area below tiles lower than their shelf
+    // and the unused tail of each shelf are cleared
+    // within a shelf the tiles are placed from left to right in the order of placements
+    cv::Scalar black(0, 0, 0);
+    std::vector<int> shelfCursors(shelves.size(), 0);
+    for (int i = 0; i < placements.size(); ++i) {
+        cv::Rect const& targetRoi = placements[i].targetRoi;
+        cv::Rect const& shelfRect = shelves[shelfOfPlacement[i]];
+        int& cursor = shelfCursors[shelfOfPlacement[i]];
+        resultImage_(cv::Rect(cursor, shelfRect.y, targetRoi.x - cursor, shelfRect.height)).setTo(black);
+        resultImage_(cv::Rect(targetRoi.x, targetRoi.br().y, targetRoi.width, shelfRect.br().y - targetRoi.br().y)).setTo(black);
+        cursor = targetRoi.br().x;
+    }
+    for (int shelf = 0; shelf < shelves.size(); ++shelf) {
+        cv::Rect const& shelfRect = shelves[shelf];
+        resultImage_(cv::Rect(shelfCursors[shelf], shelfRect.y, resultSize.width - shelfCursors[shelf], shelfRect.height)).setTo(black);
+        resultImage_.rowRange(shelfRect.br().y, std::min(shelfRect.br().y + tileSpacing, resultSize.height)).setTo(black);
+    }
+    resultImage_.rowRange(std::min(canvasHeight, resultSize.height), resultSize.height).setTo(black);
+
+    fillTargetRois(images, placements);
+}
+
+template<typename FieldEnum>
+void Collage<FieldEnum>::fillTargetRois(std::vector<cv::Mat> const& images, std::vector<RoiPlacement> const& placements) {
+    numImages_ = static_cast<int>(images.size());
+    double tileArea = 0;
+
+    for (auto const& placement : placements) {
+        cv::Rect const& originRoi = placement.originRoi;
+        cv::Rect const& targetRoi = placement.targetRoi;
 
         PerspectiveTransform imgToSubimg(1, -originRoi.x, -originRoi.y);
         PerspectiveTransform subimgToTarget;
         PerspectiveTransform targetToResultImg(1, targetRoi.x, targetRoi.y);
 
-        cv::Mat resized = imgResizeAndFill(image(originRoi), targetRoi.size(), &subimgToTarget);
-        resized.copyTo(resultImg(targetRoi));
+        cv::Mat tile = resultImage_(targetRoi);
+        imgResizeAndFill(images[placement.imageIdx](originRoi), tile, &subimgToTarget);
 
-        RoiTransformInfo roiInfo(targetRoi,
-                                 imgToSubimg.merge(subimgToTarget).merge(targetToResultImg).reverse());
+        roiTransformInfos.emplace_back(placement.imageIdx, placement.field, targetRoi,
+                                       imgToSubimg.merge(subimgToTarget).merge(targetToResultImg).reverse());
+        tileArea += targetRoi.area();
+    }
 
-        roiTransformInfos.emplace(field, roiInfo);
+    std::vector<cv::Rect> tileRois;
+    for (auto const& roiInfo : roiTransformInfos) {
+        tileRois.push_back(roiInfo.roi);
     }
+    tileGrid_ = TileGrid(tileRois);
+
+    // the ratio of the canvas actually covered by tiles, the rest is sent to the network as black pixels
+    fillRatio_ = resultImage_.empty() ? 0 : tileArea / resultImage_.size().area();
+}
+
+template<typename FieldEnum>
+EnumMap<FieldEnum, std::vector<Detection>> Collage<FieldEnum>::splitDetections(std::vector<Detection> const& dets, float overlapThresh) {
+    assert(numImages_ <= 1);
 
-    resultImage_ = resultImg;
+    std::vector<EnumMap<FieldEnum, std::vector<Detection>>> splitResults = splitDetectionsByImage(dets, overlapThresh);
+    return splitResults.empty() ? EnumMap<FieldEnum, std::vector<Detection>>() : std::move(splitResults.front());
 }
 
 template<typename FieldEnum>
-EnumHashMap<FieldEnum, std::vector<Detection>> Collage<FieldEnum>::splitDetections(std::vector<Detection> const& dets, float overlapThresh) {
-    EnumHashMap<FieldEnum, std::vector<Detection>> splitResults =
-            distributeItemsByField(dets, roiTransformInfos,
-                                   [&](Detection const& det, RoiTransformInfo const& roiInfo) {
-                                       return (det.rect & roiInfo.roi).area() > overlapThresh * det.rect.area();
-                                   });
+std::vector<EnumMap<FieldEnum, std::vector<Detection>>>
+Collage<FieldEnum>::splitDetectionsByImage(std::vector<Detection> const& dets, float overlapThresh) {
+    std::vector<EnumMap<FieldEnum, std::vector<Detection>>> splitResults(numImages_);
 
-    for (auto& fieldResult : splitResults) {
-        auto itrRoiInfo = roiTransformInfos.find(fieldResult.first);
-        if (itrRoiInfo == roiTransformInfos.end()) continue;
+    // the result of each tile is created on its first detection, each tile has a key of its own
+    std::vector<std::vector<Detection>*> tileResults(roiTransformInfos.size(), nullptr);
+    std::vector<int> candidates;
 
-        for (auto& det : fieldResult.second) {
-            det.rect = itrRoiInfo->second.backwardTransform.apply(det.rect);
+    for (auto const& det : dets) {
+        tileGrid_.query(det.rect, candidates);
+        for (int idx : candidates) {
+            RoiTransformInfo const& roiInfo = roiTransformInfos[idx];
+            if ((det.rect & roiInfo.roi).area() <= overlapThresh * det.rect.area()) continue;
+
+            if (!tileResults[idx]) tileResults[idx] = &splitResults[roiInfo.imageIdx][roiInfo.field];
+            tileResults[idx]->push_back(det);
+        }
+    }
+
+    // the detections of a tile are mapped back to its source image in one batch
+    std::vector<cv::Rect> rects;
+    for (int idx = 0; idx < tileResults.size(); ++idx) {
+        if (!tileResults[idx]) continue;
+        std::vector<Detection>& tileDets = *tileResults[idx];
+
+        rects.clear();
+        for (auto const& det : tileDets) {
+            rects.push_back(det.rect);
+        }
+        roiTransformInfos[idx].backwardTransform.apply(rects.data(), rects.data(), rects.size());
+        for (int i = 0; i < tileDets.size(); ++i) {
+            tileDets[i].rect = rects[i];
+        }
+    }
+
+    return splitResults;
+}
+
+template<typename FieldEnum>
+std::vector<EnumMap<FieldEnum, DetectionSet>>
+Collage<FieldEnum>::splitDetectionsByImage(DetectionSet const& dets, float overlapThresh) {
+    std::vector<EnumMap<FieldEnum, DetectionSet>> splitResults(numImages_);
+
+    std::vector<DetectionSet*> tileResults(roiTransformInfos.size(), nullptr);
+    std::vector<int> candidates;
+
+    for (size_t i = 0; i < dets.size(); ++i) {
+        cv::Rect rect = dets.rect(i);
+        tileGrid_.query(rect, candidates);
+        for (int idx : candidates) {
+            RoiTransformInfo const& roiInfo = roiTransformInfos[idx];
+            if ((rect & roiInfo.roi).area() <= overlapThresh * rect.area()) continue;
+
+            if (!tileResults[idx]) {
+                tileResults[idx] = &splitResults[roiInfo.imageIdx][roiInfo.field];
+                *tileResults[idx] = DetectionSet(dets.labels());
+            }
+            tileResults[idx]->add(dets.classId(i), rect, dets.score(i));
+        }
+    }
+
+    std::vector<cv::Rect> rects;
+    for (int idx = 0; idx < tileResults.size(); ++idx) {
+        if (!tileResults[idx]) continue;
+        DetectionSet& tileDets = *tileResults[idx];
+
+        rects.clear();
+        for (size_t i = 0; i < tileDets.size(); ++i) {
+            rects.push_back(tileDets.rect(i));
+        }
+        roiTransformInfos[idx].backwardTransform.apply(rects.data(), rects.data(), rects.size());
+        for (size_t i = 0; i < tileDets.size(); ++i) {
+            tileDets.setRect(i, rects[i]);
         }
     }
 
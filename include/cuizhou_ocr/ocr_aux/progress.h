@@ -0,0 +1,51 @@
+#ifndef CUIZHOU_OCR_PROGRESS_H
+#define CUIZHOU_OCR_PROGRESS_H
+
+#include <array>
+
+
+namespace cz {
+
+enum class ProcessStage { STANDARDIZE = 0, LOCATE_TEXT_BAND, DETECT_KEYS, ROTATION_PROBE, ROTATE, VIN_ROUND_1, VIN_ROUND_2, VIN_ROUND_3, GAPS, CLASSIFY, COLLAGE_PASS_1, COLLAGE_PASS_2 };
+int const NUM_PROCESS_STAGES = 12;
+
+char const* stageName(ProcessStage stage);
+
+// reported once each time a stage of processing finishes
+struct ProgressEvent {
+    ProcessStage stage;
+    double wallMs = 0;
+    double cpuMs = 0; // cpu time of the calling thread
+    long numForwards = 0; // network forwards run by the stage
+    long numInputPixels = 0; // summed over the input layers of those forwards
+    long numDetections = 0;
+
+    double inputPixelsPerForward() const;
+};
+
+// the events of one request aggregated per stage
+class StageStats {
+public:
+    struct Totals {
+        int numEvents = 0;
+        double wallMs = 0;
+        double cpuMs = 0;
+        long numForwards = 0;
+        long numInputPixels = 0;
+        long numDetections = 0;
+    };
+
+    void add(ProgressEvent const& event);
+    void clear();
+
+    Totals const& operator[](ProcessStage stage) const;
+    Totals total() const;
+
+private:
+    std::array<Totals, NUM_PROCESS_STAGES> totals_;
+};
+
+} // end namespace cz
+
+
+#endif //CUIZHOU_OCR_PROGRESS_H
@@ -0,0 +1,37 @@
+#ifndef CUIZHOU_OCR_TILE_GRID_H
+#define CUIZHOU_OCR_TILE_GRID_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+namespace cz {
+
+// a uniform grid over a set of tiles, to find the tiles a rect may overlap without testing all of them
+// each cell lists the tiles that cover it, the lists are stored back to back
+class TileGrid {
+public:
+    ~TileGrid();
+    TileGrid();
+    explicit TileGrid(std::vector<cv::Rect> const& tiles);
+
+    // indices of the tiles that may intersect the rect, ascending and without duplicates
+    void query(cv::Rect const& rect, std::vector<int>& candidates) const;
+
+private:
+    static int const MAX_CELLS_PER_SIDE = 64;
+
+    cv::Rect extent_;
+    cv::Size cellSize_;
+    int numCols_ = 0;
+    int numRows_ = 0;
+    std::vector<int> cellStarts_;
+    std::vector<int> cellTiles_;
+
+    cv::Rect cellRange(cv::Rect const& rect) const;
+};
+
+} // end namespace cz
+
+
+#endif //CUIZHOU_OCR_TILE_GRID_H
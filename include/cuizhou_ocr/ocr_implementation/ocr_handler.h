@@ -5,31 +5,112 @@
 #ifndef OCR_CUIZHOU_OCRHANDLER_H
 #define OCR_CUIZHOU_OCRHANDLER_H
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <string>
+#include <vector>
 #include <opencv2/core/core.hpp>
+#include "normalized_image.h"
+#include "mlmodel.h"
+#include "tracing.h"
+#include "metrics.h"
+#include "data_utils/raw_frame.h"
+#include "ocr_aux/progress.h"
 
 
 namespace cz {
 
 class OcrHandler {
 public:
-    using ShowProgress = std::function<void(OcrHandler const& ocrHandler, int stage)>;
+    using ShowProgress = std::function<void(OcrHandler const& ocrHandler, ProgressEvent const& event)>;
 
     virtual ~OcrHandler();
 
     void importImage(cv::Mat const& image);
     void setImageSource(cv::Mat const& image);
+    // decode an encoded image, JPEG streams are decoded directly at a reduced scale close to standardSize()
+    void importEncoded(uint8_t const* data, size_t size);
+    // import a frame in the native format of a capture device, converting it directly at standardSize() if there is one
+    void importFrame(RawFrame const& frame);
     virtual void processImage(ShowProgress const& showProgress = ShowProgress()) = 0;
+    // process a batch of images and return the result of each as a string
+    // the state of the handler is left with the last image of the batch
+    virtual std::vector<std::string> processImages(std::vector<cv::Mat> const& images,
+                                                   ShowProgress const& showProgress = ShowProgress());
 
     cv::Mat const& image() const;
+    // the size images are standardized to before processing, empty if the handler processes them at any size
+    virtual cv::Size standardSize() const;
 
     virtual cv::Mat drawResult() const = 0;
     virtual std::string getResultAsString() const = 0;
 
+    // stages are timed only if stats are enabled or a progress callback is given to the current request
+    void setStageStatsEnabled(bool enabled);
+    // per-stage stats of the last processImage() or processImages() call
+    StageStats const& stageStats() const;
+
+    // detect keys only within the text band located by edge statistics, for handlers that support it
+    // the whole image is used whenever the band is not located confidently
+    void setTextBandCropEnabled(bool enabled);
+
 protected:
+    // reports a progress event for the stage when it goes out of scope, and traces the stage if tracing is enabled
+    class StageTimer {
+    public:
+        ~StageTimer();
+        StageTimer(OcrHandler& handler, ProcessStage stage);
+
+        void setNumDetections(long numDetections);
+
+    private:
+        tracing::Scope traceScope_;
+        OcrHandler* handler_; // null if nothing is timed
+        ProgressEvent event_;
+        ForwardStats forwardStatsStart_;
+        double wallMsStart_ = 0;
+        double cpuMsStart_ = 0;
+    };
+
     cv::Mat image_;
 
     OcrHandler();
+
+    // to be called at the start and the end of processing, endRequest() may be called once per batch of images
+    void beginRequest(ShowProgress const& showProgress);
+    void endRequest(int numImages = 1);
+    // the forwards run so far by all models of the handler
+    virtual ForwardStats modelForwardStats() const;
+    bool isTextBandCropEnabled() const;
+
+    // replace image_ and drop everything derived from the previous one
+    void updateImage(cv::Mat const& image);
+    // letterbox image_ to the given size in a reused frame buffer, nothing is done if it has the size already
+    void standardizeImage(cv::Size const& size);
+    // rotate image_ around its center in a reused frame buffer
+    void rotateImage(double angleInDegree);
+    // the normalized copy of image_ shared by detections on its sub-regions, computed on first use
+    NormalizedImage const& normalizedImage();
+
+private:
+    bool stageStatsEnabled_ = false;
+    bool textBandCropEnabled_ = false;
+    StageStats stageStats_;
+    ShowProgress showProgress_;
+    uint64_t requestStartUs_ = 0; // 0 if metrics were disabled at the start of the request
+    ForwardStats requestForwardStats_;
+
+    bool isTimingStages() const;
+    void reportProgress(ProgressEvent const& event);
+
+    // frame buffers written in place by every request, so that the steady state allocates no full frames
+    cv::Mat importedFrame_;
+    cv::Mat standardizedFrame_;
+    cv::Mat rotatedFrame_;
+    cv::Mat rawFrameScratch_;
+
+    NormalizedImage normalizedImage_;
 };
 
 } // end namespace cz
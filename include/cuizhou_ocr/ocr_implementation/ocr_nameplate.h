@@ -5,10 +5,10 @@
 #ifndef OCR_CUIZHOU_OCRNAMEPLATES_H
 #define OCR_CUIZHOU_OCRNAMEPLATES_H
 
-#include <map>
 #include "ocr_implementation/ocr_handler.h"
 #include "ocr_aux/keyvalue_detection.h"
 #include "ocr_aux/classname_dict.hpp"
+#include "data_utils/enum_map.hpp"
 
 
 namespace cz {
@@ -16,6 +16,13 @@ namespace cz {
 class OcrNameplate : public OcrHandler {
 protected:
     enum class NameplateField { UNKNOWN = -1, VIN = 0, MANUFACTURER, BRAND, MAX_MASS_ALLOWED, MAX_NET_POWER_OF_ENGINE, COUNTRY, FACTORY, ENGINE_MODEL, NUM_PASSENGERS, VEHICLE_MODEL, ENGINE_DISPLACEMENT, DATE_OF_MANUFACTURE, PAINT };
+    // capacity of the maps keyed by fields, UNKNOWN is never stored in them
+    // EnumMap finds it through ADL, the alias spells it out since the class is incomplete here
+    static constexpr size_t NUM_NAMEPLATE_FIELDS = 13;
+    friend constexpr size_t enumCapacity(NameplateField) { return NUM_NAMEPLATE_FIELDS; }
+
+    template<typename T>
+    using FieldMap = EnumMap<NameplateField, T, NUM_NAMEPLATE_FIELDS>;
 
 public:
     virtual ~OcrNameplate() override;
@@ -30,7 +37,7 @@ public:
 
 protected:
     static ClassnameDict<NameplateField> const fieldDict_;
-    std::map<NameplateField, KeyValueDetection> result_;
+    FieldMap<KeyValueDetection> result_;
 
     OcrNameplate();
 };
@@ -8,8 +8,8 @@
 #include "detector.h"
 #include "classifier.h"
 #include "ocr_implementation/ocr_nameplate.h"
-#include "data_utils/enum_hashmap.hpp"
 #include "ocr_aux/collage.hpp"
+#include "ocr_aux/detection_proc.h"
 
 
 namespace cz{
@@ -25,28 +25,54 @@ public:
                           Classifier classifierChars);
 
     virtual void processImage(ShowProgress const& showProgress = ShowProgress()) override;
+    virtual std::vector<std::string> processImages(std::vector<cv::Mat> const& images,
+                                                   ShowProgress const& showProgress = ShowProgress()) override;
+
+    virtual cv::Size standardSize() const override;
+
+protected:
+    virtual ForwardStats modelForwardStats() const override;
 
 private:
-    static EnumHashMap<NameplateField, int> const VALUE_LENGTH;
+    // per-image state stashed while other images of the same batch are processed
+    struct ImageState {
+        cv::Mat image;
+        FieldMap<OcrDetection> keyOcrDetections;
+        FieldMap<KeyValueDetection> result;
+    };
+
+    static FieldMap<int> const VALUE_LENGTH;
+    // the slots the stitched fields were letterboxed into by the fixed 1056x640 collage the detector was trained on
+    static FieldMap<cv::Size> const COLLAGE_SLOT_SIZE;
 
     Detector detectorKeys_;
     Detector detectorValuesVin_; // used for VIN
     Detector detectorValuesStitched_; // used for detect other values in stitched sub-images
     Classifier classifierChars_;
+    std::vector<NameplateField> keyFieldOfClass_; // the field of each class of the key detector
+    CharClasses vinChars_; // of the VIN value detector
+    CharClasses stitchedChars_; // of the stitched value detector
+
+    FieldMap<OcrDetection> keyOcrDetections_;
+    cv::Mat collageCanvas_; // reused by the collages of every request
 
-    std::map<NameplateField, OcrDetection> keyOcrDetections_;
+    void processImageBeforeCollage();
+    void stashState(ImageState& state);
+    void restoreState(ImageState& state);
+    void recordFieldMetrics() const;
 
+    cv::Rect locateKeysRoi();
     void detectKeys();
     void detectValueOfVin();
-    void detectValuesOfOtherCodeFields();
+    void detectValuesOfOtherCodeFields(std::vector<ImageState>& states);
     void adaptiveRotationWithUpdatingKeyDetections();
 
-    void addGapDetections(std::vector<Detection>& dets, cv::Rect const& roi);
-    void updateByClassification(std::vector<Detection>& dets, cv::Mat const& srcImg) const;
-    static void postprocessStitchedDetections(EnumHashMap<NameplateField, std::vector<Detection>>& stitchedDets);
+    void addGapDetections(DetectionSet& dets, cv::Rect const& roi);
+    void updateByClassification(DetectionSet& dets, cv::Mat const& srcImg, CharClasses const& chars) const;
+    void postprocessStitchedDetections(FieldMap<DetectionSet>& stitchedDets) const;
 
     static cv::Rect estimateValueRoi(NameplateField field, cv::Rect const& keyRoi);
-    static void eliminateOverlaps(std::vector<Detection>& dets, NameplateField field);
+    static void eliminateOverlaps(DetectionSet& dets, NameplateField field, CharClasses const& chars);
     static bool shouldContainLetters(NameplateField field);
 };
 
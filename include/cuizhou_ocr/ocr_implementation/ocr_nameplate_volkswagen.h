@@ -22,7 +22,7 @@ public:
     virtual void processImage(ShowProgress const& showProgress = ShowProgress()) override;
 
 private:
-    static EnumHashMap<NameplateField, int> const VALUE_LENGTH;
+    static FieldMap<int> const VALUE_LENGTH;
 
     Detector detectorValues_;
 };
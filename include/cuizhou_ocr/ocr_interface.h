@@ -25,12 +25,23 @@ public:
 
     void importImage(cv::Mat const& img);
     void setImageSource(cv::Mat const& img);
+    void importEncoded(uint8_t const* data, size_t size);
+    void importFrame(RawFrame const& frame);
     void processImage(OcrHandler::ShowProgress const& showProgress = OcrHandler::ShowProgress());
+    std::vector<std::string> processImages(std::vector<cv::Mat> const& images,
+                                           OcrHandler::ShowProgress const& showProgress = OcrHandler::ShowProgress());
 
     cv::Mat const& image() const;
+    // the size images are standardized to before processing, empty if they are processed at any size
+    cv::Size standardSize() const;
     cv::Mat drawResult() const;
     std::string getResultAsString() const;
 
+    void setStageStatsEnabled(bool enabled);
+    StageStats const& stageStats() const;
+
+    void setTextBandCropEnabled(bool enabled);
+
 private:
     std::shared_ptr<OcrHandler> ocrHandler_;
 };
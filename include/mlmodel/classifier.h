@@ -6,6 +6,7 @@
 #include <caffe/caffe.hpp>
 #include "mlmodel.h"
 #include "classification.h"
+#include "mock_backend.h"
 
 
 namespace cz {
@@ -20,6 +21,11 @@ public:
               std::string const& mean_file,
               std::vector<std::string> const& label);
 
+    // answer classifications from a fixture, or synthesize them, instead of running a network
+    void initMock(std::vector<std::string> const& labels, MockOptions const& options = MockOptions());
+    // append the outputs of the network to a fixture that initMock() can replay
+    void recordTo(std::string const& fixturePath);
+
     std::vector<Classification> classify(cv::Mat const& img, int n = 5) const;
 
 private:
@@ -28,6 +34,7 @@ private:
     int num_channels_;
     cv::Mat mean_;
     std::vector<std::string> labels_;
+    std::shared_ptr<MockBackend> mock_;
 
     void setMean(std::string const& mean_file);
     std::vector<float> predict(cv::Mat const& img) const;
@@ -0,0 +1,31 @@
+#ifndef CUIZHOU_OCR_DETECTION_KERNELS_H
+#define CUIZHOU_OCR_DETECTION_KERNELS_H
+
+#include "detection_set.h"
+
+
+namespace cz {
+namespace kernels {
+
+// post-processing of the faster-rcnn outputs, free of the network so that it can be benchmarked in isolation
+// boxes are rows of 5 floats (x1, y1, x2, y2, score)
+
+float iou(const float A[], const float B[]);
+
+// greedy non-maximum suppression over boxes sorted by score descending
+void nms(int* keep_out, int* num_out, const float* boxes_host, int boxes_num, int boxes_dim, float nms_overlap_thresh);
+
+// sort the boxes by score descending
+void boxes_sort(int num, const float* pred, float* sorted_pred);
+
+// apply the regression deltas of every class to the proposals, pred is laid out class by class
+void bbox_transform_inv(int num, int class_num, const float* box_deltas, const float* pred_cls, const float* boxes, float* pred, int img_height, int img_width);
+
+// append the kept boxes to the detections of the class until the score drops below the threshold
+void overThresh(const int* keep, int num_out, const float* sorted_pred_cls, float conf_thresh, int class_id, DetectionSet& dets);
+
+} // end namespace kernels
+} // end namespace cz
+
+
+#endif //CUIZHOU_OCR_DETECTION_KERNELS_H
@@ -0,0 +1,71 @@
+#ifndef CUIZHOU_OCR_DETECTION_SET_H
+#define CUIZHOU_OCR_DETECTION_SET_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "detection.h"
+
+
+namespace cz {
+
+// the class names of a model, detections refer to them by index
+using LabelTable = std::vector<std::string>;
+
+// detections stored as parallel arrays, each labelled by the index of its class in a table shared with the model
+// rects are kept as their corners (x1, y1) inclusive and (x2, y2) exclusive
+class DetectionSet {
+public:
+    ~DetectionSet();
+    DetectionSet();
+    explicit DetectionSet(std::shared_ptr<LabelTable const> labels);
+
+    // throws std::invalid_argument on a label missing from the table
+    static DetectionSet fromDetections(std::vector<Detection> const& dets, std::shared_ptr<LabelTable const> labels);
+    std::vector<Detection> toDetections() const;
+
+    size_t size() const;
+    bool empty() const;
+    void reserve(size_t capacity);
+    void clear();
+    void add(int classId, cv::Rect const& rect, float score);
+    // append the detections of a set labelled by the same table
+    void append(DetectionSet const& other);
+    void erase(size_t idx);
+    // keep the detections at the indices, in the order of the indices
+    void select(std::vector<size_t> const& indices);
+
+    cv::Rect rect(size_t idx) const;
+    float score(size_t idx) const;
+    int classId(size_t idx) const;
+    std::string const& label(size_t idx) const;
+    void setRect(size_t idx, cv::Rect const& rect);
+    void setClass(size_t idx, int classId, float score);
+    std::shared_ptr<LabelTable const> const& labels() const;
+
+    // index of the label in the table, -1 if it is not there
+    int classIdOf(std::string const& label) const;
+
+    // the detections of one class, in their current order
+    DetectionSet selectClass(int classId) const;
+
+    // IoU of the idx-th rect with each rect, written to ious[0, size())
+    void computeIous(size_t idx, float* ious) const;
+    // sort by the x-mid of the rects, ties keep their order
+    void sortByXMid();
+    // the smallest rect containing all the non-empty rects, as their union by cv::Rect::operator| would be
+    cv::Rect extent() const;
+
+private:
+    std::shared_ptr<LabelTable const> labels_;
+    std::vector<int> x1_, y1_, x2_, y2_;
+    std::vector<float> scores_;
+    std::vector<uint16_t> classIds_;
+};
+
+} // end namespace cz
+
+
+#endif //CUIZHOU_OCR_DETECTION_SET_H
@@ -6,6 +6,9 @@
 #include <vector>
 #include "mlmodel.h"
 #include "detection.h"
+#include "detection_set.h"
+#include "normalized_image.h"
+#include "mock_backend.h"
 
 
 namespace cz {
@@ -19,36 +22,44 @@ public:
 			  std::string const& net_weights,
 			  std::vector<std::string> const& classes);
 
+	// answer detections from a fixture, or synthesize them, instead of running a network
+	void initMock(std::vector<std::string> const& classes, MockOptions const& options = MockOptions());
+	// append the outputs of the network to a fixture that initMock() can replay
+	void recordTo(std::string const& fixturePath);
+
 	void setComputeMode(std::string const& mode = "cpu", int id = 0);
 	void setThresh(float conf_thresh = 0.7, float nms_thresh = 0.3);
+	void setFixedScale(float scale = 0);
+	// the factor an input of the size is scaled by before the network, the fixed scale if it is set
+	float fitScale(cv::Size const& size) const;
 
 	std::vector<Detection> detect(cv::Mat const& img) const;
+	// same as above, the detections are labelled by their indices in labels()
+	DetectionSet detectSet(cv::Mat const& img) const;
 	std::vector<Detection> detect(cv::Mat const& img, std::string const& class_mask) const;
+	// detect within a region of a pre-normalized image, coordinates of the detections are relative to the region
+	std::vector<Detection> detect(NormalizedImage const& img, cv::Rect const& roi) const;
+	// same as above, labelled by indices
+	DetectionSet detectSet(NormalizedImage const& img, cv::Rect const& roi) const;
+
+	std::shared_ptr<LabelTable const> const& labels() const;
 
 	static void drawBox(cv::Mat& img, std::vector<Detection> const& dets);
 
 private:
-	std::vector<std::string> m_classes;
+	std::shared_ptr<LabelTable const> m_classes; // shared by copies and by the detection sets
 	std::shared_ptr<caffe::Net<float>> m_net;
+	std::shared_ptr<MockBackend> m_mock; // shared by copies, so that they record into the same fixture
 	float m_confThresh;
 	float m_nmsThresh;
+	float m_fixedScale = 0; // scale the input by this factor instead of fitting it to SCALES if positive
 
 	static int const SCALE_MULTIPLE_OF = 32;
 	static int const MAX_SIZE = 1280;
 	static int const SCALES = 640;
 
 	void detectAux(cv::Mat img, float* pred, int& rpn_num) const;
-	std::vector<Detection> overThresh(int* keep, int num_out, float* sorted_pred_cls, float CONF_THRESH, std::string className) const;
-
-	static float iou(const float A[], const float B[]);
-	static void nms(int* keep_out, int* num_out, const float* boxes_host, int boxes_num, int boxes_dim, float nms_overlap_thresh);
-	static void boxes_sort(int num, const float* pred, float* sorted_pred);
-	void bbox_transform_inv(const int num, const float* box_deltas, const float* pred_cls, float* boxes, float* pred, int img_height, int img_width) const;
-
-	struct Info {
-		float score;
-		const float* head;
-	};
+	uint64_t hashInput(NormalizedImage const& img, cv::Rect const& roi) const;
 };
 
 }
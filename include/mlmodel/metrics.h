@@ -0,0 +1,95 @@
+#ifndef CUIZHOU_OCR_METRICS_H
+#define CUIZHOU_OCR_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+
+namespace cz {
+namespace metrics {
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+// metrics are only updated while enabled, so that disabled workers pay a single relaxed load per update site
+inline bool isEnabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool enabled);
+
+class Counter {
+public:
+    void add(uint64_t n = 1);
+    uint64_t value() const;
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// log-linear histogram of non-negative integers in the style of HdrHistogram
+// every power of two is split into SUB_BUCKETS linear buckets, which bounds the relative error of quantiles by 1/SUB_BUCKETS
+class Histogram {
+public:
+    static int const SUB_BUCKETS = 16;
+    static int const NUM_BUCKETS = SUB_BUCKETS + (64 - 4) * SUB_BUCKETS;
+
+    void record(uint64_t value);
+
+    uint64_t count() const;
+    uint64_t sum() const;
+    // the midpoint of the bucket holding the q-th quantile, 0 if nothing is recorded
+    double quantile(double q) const;
+
+private:
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+
+    static int bucketIndex(uint64_t value);
+    static double bucketMidpoint(int index);
+};
+
+// labels are given in Prometheus syntax, e.g. stage="detect_keys"
+// the returned references stay valid for the lifetime of the process, callers may cache them
+Counter& counter(std::string const& name, std::string const& help, std::string const& labels = "");
+Histogram& histogram(std::string const& name, std::string const& help, std::string const& labels = "");
+
+// counters are written as counters, histograms as summaries with the 0.5, 0.95 and 0.99 quantiles
+void writePrometheus(std::ostream& strm);
+// written to a temporary file first and renamed, so that readers never see a partial file
+bool writePrometheusTextfile(std::string const& path);
+
+// rewrites a textfile for node-exporter's textfile collector periodically from a background thread
+class TextfileExporter {
+public:
+    ~TextfileExporter();
+    TextfileExporter() = delete;
+
+    TextfileExporter(std::string path, int intervalMs);
+
+    TextfileExporter(TextfileExporter const&) = delete;
+    TextfileExporter& operator=(TextfileExporter const&) = delete;
+
+private:
+    std::string path_;
+    int intervalMs_;
+    bool stopping_ = false;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    void run();
+};
+
+} // end namespace metrics
+} // end namespace cz
+
+#endif //CUIZHOU_OCR_METRICS_H
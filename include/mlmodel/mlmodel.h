@@ -8,12 +8,25 @@
 
 namespace cz {
 
+// network forwards run by a model, for profiling
+struct ForwardStats {
+    long numForwards = 0;
+    long numInputPixels = 0; // summed over the input layers of the forwards
+};
+
 class MlModel {
 public:
     virtual ~MlModel();
 
+    ForwardStats const& forwardStats() const;
+
 protected:
     MlModel();
+
+    void countForward(long numInputPixels) const;
+
+private:
+    mutable ForwardStats forwardStats_;
 };
 
 } // end namespace cz
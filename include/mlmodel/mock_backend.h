@@ -0,0 +1,64 @@
+#ifndef CUIZHOU_OCR_MOCK_BACKEND_H
+#define CUIZHOU_OCR_MOCK_BACKEND_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "detection.h"
+#include "classification.h"
+
+
+namespace cz {
+
+struct MockOptions {
+    std::string fixturePath; // outputs recorded under the hashes of their inputs, replayed if the input matches
+    double latencyMs = 0; // simulated duration of every forward
+    bool busyWait = false; // spin instead of sleeping, so that the simulated forward occupies a core as on CPU
+};
+
+// stands in for the network of a Detector or Classifier, so that the pipeline runs deterministically without models
+// inputs missing from the fixture get synthetic outputs seeded by their hash: a line of characters for wide regions
+// and a column of distinct classes for others, which is roughly what the key detector sees on a nameplate
+class MockBackend {
+public:
+    ~MockBackend();
+    MockBackend() = delete;
+
+    MockBackend(std::vector<std::string> labels, MockOptions options);
+    // a backend that only appends real outputs to the fixture, the same one is returned for every call with a path
+    static std::shared_ptr<MockBackend> recorder(std::string const& fixturePath);
+
+    bool isRecording() const;
+    void simulateLatency() const;
+
+    std::vector<Detection> detect(uint64_t inputHash, cv::Size const& inputSize, float confThresh) const;
+    std::vector<Classification> classify(uint64_t inputHash, int n) const;
+
+    void recordDetections(uint64_t inputHash, std::vector<Detection> const& dets);
+    void recordClassifications(uint64_t inputHash, std::vector<Classification> const& clss);
+
+    static uint64_t hashPixels(cv::Mat const& img, uint64_t seed);
+    static uint64_t hashCombine(uint64_t seed, uint64_t value);
+
+private:
+    std::vector<std::string> labels_; // background at index 0 is never synthesized
+    MockOptions options_;
+    std::unordered_map<uint64_t, std::vector<Detection>> fixtureDetections_;
+    std::unordered_map<uint64_t, std::vector<Classification>> fixtureClassifications_;
+
+    bool recording_ = false;
+    std::mutex recordMutex_;
+    std::ofstream recordFile_;
+
+    void loadFixture(std::string const& path);
+    std::vector<Detection> synthesizeDetections(uint64_t inputHash, cv::Size const& inputSize) const;
+};
+
+} // end namespace cz
+
+#endif //CUIZHOU_OCR_MOCK_BACKEND_H
@@ -0,0 +1,58 @@
+#ifndef CUIZHOU_OCR_MODEL_PROFILER_H
+#define CUIZHOU_OCR_MODEL_PROFILER_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <caffe/caffe.hpp>
+#include <opencv2/core/core.hpp>
+
+
+namespace cz {
+
+struct LayerProfile {
+    std::string name;
+    std::string type;
+    double wallMs = 0; // averaged over the profiled runs
+    std::vector<std::string> topShapes;
+    long topBytes = 0;
+    long paramBytes = 0;
+    double flops = 0; // exact for convolutions and inner products, one per output element for other layers
+};
+
+// times a network layer by layer with ForwardFromTo
+// timings are only meaningful in CPU mode, GPU layers return before their kernels finish
+class ModelProfiler {
+public:
+    ~ModelProfiler();
+    ModelProfiler() = delete;
+
+    ModelProfiler(std::string const& model_file, std::string const& trained_file);
+
+    // reshape an input blob and fill it with random pixel-like values
+    // an "im_info" blob is kept consistent with the shape of "data"
+    void setInputShape(std::string const& blob_name, std::vector<int> const& shape);
+    // fill the "data" blob with a mean-subtracted image resized to its current shape
+    void setInputImage(cv::Mat const& img);
+
+    void profile(int numRuns = 10, int numWarmupRuns = 2);
+
+    std::vector<LayerProfile> const& layers() const;
+    double totalWallMs() const;
+    double totalFlops() const;
+
+    void printTable(std::ostream& strm) const;
+    void printJson(std::ostream& strm) const;
+
+private:
+    std::shared_ptr<caffe::Net<float>> net_;
+    std::vector<LayerProfile> layers_;
+
+    void updateImInfo();
+    void collectLayerStats();
+};
+
+} // end namespace cz
+
+#endif //CUIZHOU_OCR_MODEL_PROFILER_H
@@ -0,0 +1,40 @@
+#ifndef CUIZHOU_OCR_NORMALIZED_IMAGE_H
+#define CUIZHOU_OCR_NORMALIZED_IMAGE_H
+
+#include <opencv2/core/core.hpp>
+
+
+namespace cz {
+
+// a mean-subtracted copy of an 8-bit BGR image stored as three float planes
+// it is computed once per image, so that detections on sub-regions of the image only need to resize and copy
+class NormalizedImage {
+public:
+    static float const PIXEL_MEANS[3];
+
+    ~NormalizedImage();
+    NormalizedImage();
+
+    explicit NormalizedImage(cv::Mat const& img);
+
+    // the buffer of the planes is reused if the size does not change
+    void assign(cv::Mat const& img);
+    void invalidate();
+
+    // true if this is computed from the same pixel buffer as img
+    // writes into that buffer are not tracked, call invalidate() after modifying it in place
+    bool isNormalizedFrom(cv::Mat const& img) const;
+
+    bool empty() const;
+    cv::Size size() const;
+    cv::Mat const& plane(int channel) const;
+
+private:
+    cv::Mat source_; // keeps the source buffer alive so that its address cannot be reused by another image
+    cv::Mat data_;
+    cv::Mat planes_[3];
+};
+
+} // end namespace cz
+
+#endif //CUIZHOU_OCR_NORMALIZED_IMAGE_H
@@ -0,0 +1,85 @@
+#ifndef CUIZHOU_OCR_TRACING_H
+#define CUIZHOU_OCR_TRACING_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// trace scopes are compiled in unless CZ_TRACING is defined as 0, and recorded only while enabled at runtime
+#ifndef CZ_TRACING
+#define CZ_TRACING 1
+#endif
+
+
+namespace cz {
+namespace tracing {
+
+namespace detail {
+extern std::atomic<bool> enabled;
+}
+
+inline bool isEnabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool enabled);
+
+// microseconds on a monotonic clock
+uint64_t nowUs();
+
+// names and categories must be string literals, they are stored by pointer
+// every thread records into its own ring buffer, the oldest events are overwritten when it is full
+void record(char const* name, char const* category, uint64_t beginUs, uint64_t endUs);
+
+// write the events currently held by all ring buffers as Chrome trace_event JSON
+void writeChromeTrace(std::ostream& strm);
+bool writeChromeTrace(std::string const& path);
+
+// write a trace to "<pathPrefix>-<count>.json" after every n-th finished request, never if n <= 0
+void setAutoDump(int everyNRequests, std::string const& pathPrefix);
+void countRequest();
+
+// records a complete event covering its lifetime
+class Scope {
+public:
+    explicit Scope(char const* name, char const* category = "ocr") {
+#if CZ_TRACING
+        if (isEnabled()) {
+            name_ = name;
+            category_ = category;
+            beginUs_ = nowUs();
+        }
+#endif
+    }
+
+    ~Scope() {
+#if CZ_TRACING
+        if (name_) record(name_, category_, beginUs_, nowUs());
+#endif
+    }
+
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+private:
+    char const* name_ = nullptr;
+    char const* category_ = nullptr;
+    uint64_t beginUs_ = 0;
+};
+
+} // end namespace tracing
+} // end namespace cz
+
+#define CZ_TRACE_CONCAT_AUX(a, b) a##b
+#define CZ_TRACE_CONCAT(a, b) CZ_TRACE_CONCAT_AUX(a, b)
+
+#if CZ_TRACING
+#define CZ_TRACE_SCOPE(name) cz::tracing::Scope CZ_TRACE_CONCAT(czTraceScope, __LINE__)(name)
+#define CZ_TRACE_SCOPE_CAT(name, category) cz::tracing::Scope CZ_TRACE_CONCAT(czTraceScope, __LINE__)(name, category)
+#else
+#define CZ_TRACE_SCOPE(name)
+#define CZ_TRACE_SCOPE_CAT(name, category)
+#endif
+
+#endif //CUIZHOU_OCR_TRACING_H
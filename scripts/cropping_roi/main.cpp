@@ -2,94 +2,134 @@
 // Created by Zhihao Liu on 3/28/18.
 //
 
-#include <iostream>
+// crop the text band of every nameplate photo of a directory into two overlapping training images
+//
+// usage: cropping_roi <src_dir> <dst_img_dir> <dst_info_dir> [--threads N]
+//
+// the photos are processed on a pool of threads, each of which holds one photo at a time from decode to encode,
+// so that the number of decoded images in memory is bounded by the number of threads
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
-#include <dirent.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 #include "opencv2/core.hpp"
-#include "opencv2/imgproc.hpp"
-#include "opencv2/highgui.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "data_utils/text_band.h"
 
 using namespace std;
 using namespace cv;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Progress {
+    atomic<long> numDone{0};
+    atomic<long> numSkipped{0}; // no edges were found or the photo failed to decode
+};
+
+// returns false if the photo is skipped
+bool cropImage(fs::path const& imgPath, string const& dstDir, string const& infoDir) {
+    Mat imgBgr = imread(imgPath.string());
+    if (imgBgr.empty()) return false;
+
+    cz::TextBand band = cz::locateTextBand(imgBgr);
+    if (band.rect.area() == 0) return false;
+
+    int top = band.rect.y;
+    int height = band.rect.height;
+    vector<Rect> rois = {
+            Rect(Point(0, top), Size(imgBgr.cols * 2 / 3, height)),
+            Rect(Point(imgBgr.cols / 3, top), Size(imgBgr.cols * 2 / 3, height))
+    };
+
+    string imgName = imgPath.stem().string();
+    for (int i = 0; i < rois.size(); ++i) {
+        Rect const& roi = rois[i];
+        string outputName = imgName + "-cropped-" + to_string(i);
+
+        imwrite(dstDir + outputName + ".jpg", imgBgr(roi));
+
+        ofstream fout(infoDir + outputName + ".txt");
+        fout << roi.tl().x << endl;
+        fout << roi.tl().y << endl;
+        fout << roi.br().x << endl;
+        fout << roi.br().y << endl;
+    }
+    return true;
+}
 
-int main(int argc, char *argv[]) {
-    string srcDir = "/Users/liuzhihao/Dropbox/Advancement/Internship Cuizhou/OCR/Labeling AlfaRomeo/full-size/img/";
-    string dstDir = "/Users/liuzhihao/Desktop/cropped/img/";
-    string infoDir = "/Users/liuzhihao/Desktop/cropped/info/";
-
-    DIR* dir;
-    struct dirent* de;
-
-    dir = opendir(srcDir.c_str());
-    while ((de = readdir(dir)) != nullptr) {
-        string fileName = de->d_name;
-        if (fileName.length() < 4 || fileName.substr(fileName.length() - 4, fileName.length()) != ".jpg") continue;
-        string imgName = fileName.substr(0, fileName.length() - 4);
+void reportProgress(Progress const& progress, long total, double elapsedSec) {
+    long numDone = progress.numDone;
+    double imagesPerSec = elapsedSec > 0 ? numDone / elapsedSec : 0;
+    double etaSec = imagesPerSec > 0 ? (total - numDone) / imagesPerSec : 0;
+    cerr << "\r" << numDone << "/" << total << " photos, " << progress.numSkipped << " skipped, "
+         << static_cast<long>(imagesPerSec) << " photos/s, eta " << static_cast<long>(etaSec) << " s   " << flush;
+}
 
-        string imgPath = srcDir + fileName;
-        Mat imgRgb = imread(imgPath);
-        Mat img = imgRgb.clone();
-        cvtColor(img, img, CV_RGB2GRAY);
+void printUsage(char const* program) {
+    cerr << "Usage: " << program << " <src_dir> <dst_img_dir> <dst_info_dir> [--threads N]" << endl;
+}
 
-        GaussianBlur(img, img, Size(3, 3), 0.51);
-        Canny(img, img, 250, 100);
+} // end namespace
 
-        int gapRadius = 6;
-        int const numberOfLine = 8;
-        int indexOfLine[numberOfLine];
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    string srcDir = argv[1];
+    string dstDir = string(argv[2]) + "/";
+    string infoDir = string(argv[3]) + "/";
+
+    int numThreads = max(1u, thread::hardware_concurrency());
+    for (int i = 4; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "--threads") numThreads = max(1, atoi(argv[i + 1]));
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
 
-        for (int k = 0; k < numberOfLine; k++) {
-            float mostSum = 0;
+    vector<fs::path> imgPaths;
+    for (auto const& entry : fs::directory_iterator(srcDir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".jpg") imgPaths.push_back(entry.path());
+    }
+    long total = static_cast<long>(imgPaths.size());
 
-            for (int i = gapRadius; i < img.rows - gapRadius; i += gapRadius) {
-                float sumValueOfGap = 0;
-                for (int j = -gapRadius; j <= gapRadius; j++)
-                    sumValueOfGap += sum(img.row(i + j))[0];
+    // the photos are parallelized over, so the internal threads of OpenCV would only oversubscribe the cores
+    setNumThreads(1);
 
-                if (sumValueOfGap > mostSum) {
-                    mostSum = sumValueOfGap;
-                    indexOfLine[k] = i;
-                }
+    Progress progress;
+    atomic<long> nextIdx{0};
+    auto startTime = chrono::steady_clock::now();
 
+    vector<thread> workers;
+    for (int i = 0; i < numThreads; ++i) {
+        workers.emplace_back([&] {
+            for (long idx = nextIdx++; idx < total; idx = nextIdx++) {
+                if (!cropImage(imgPaths[idx], dstDir, infoDir)) ++progress.numSkipped;
+                ++progress.numDone;
             }
+        });
+    }
 
-            for (int j = -gapRadius; j <= gapRadius; j++)
-                img.row(indexOfLine[k] + j).setTo(0);
-
-        }
-
-        sort(indexOfLine, indexOfLine + numberOfLine);
-        int centerY = indexOfLine[numberOfLine / 2 - 1] + indexOfLine[numberOfLine / 2];
-        centerY /= 2;
-
-        int windowRadius = img.rows / 6;
-        int top = centerY - windowRadius;
-        int bot = centerY + windowRadius;
-        if (top < 0) top = 0;
-        if (bot >img.rows - 1) bot = img.rows - 1;
-
-        vector<Rect> rois = {
-                Rect(Point(0, top), Size(img.cols * 2 / 3, bot - top + 1)),
-                Rect(Point(img.cols / 3, top), Size(img.cols * 2 / 3, bot - top + 1))
-        };
-
-        for (int i = 0; i < rois.size(); ++i) {
-            Rect const& roi = rois[i];
-            string outputName = imgName + "-cropped-" + to_string(i);
-
-            Mat imgCropped = imgRgb(roi);
-            imwrite(dstDir + outputName + ".jpg", imgCropped);
-
-            ofstream fout(infoDir + outputName + ".txt");
-            fout << roi.tl().x << endl;
-            fout << roi.tl().y << endl;
-            fout << roi.br().x << endl;
-            fout << roi.br().y << endl;
-            fout.close();
-        }
+    auto elapsedSec = [&] { return chrono::duration<double>(chrono::steady_clock::now() - startTime).count(); };
+    while (progress.numDone < total) {
+        reportProgress(progress, total, elapsedSec());
+        this_thread::sleep_for(chrono::seconds(1));
+    }
+    for (auto& worker : workers) {
+        worker.join();
     }
-    closedir(dir);
+    reportProgress(progress, total, elapsedSec());
 
-    cout << "DONE" << endl;
+    cout << endl << "DONE in " << elapsedSec() << " s with " << numThreads << " threads" << endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include "data_utils/affine_transform.h"
+
+
+namespace cz {
+
+AffineTransform::~AffineTransform() = default;
+
+AffineTransform::AffineTransform() = default;
+
+AffineTransform::AffineTransform(double a, double b, double tx, double c, double d, double ty)
+        : a_(a), b_(b), tx_(tx), c_(c), d_(d), ty_(ty) {}
+
+AffineTransform::AffineTransform(PerspectiveTransform const& transform)
+        : AffineTransform(transform.scaleX_, 0, transform.offsetX_, 0, transform.scaleY_, transform.offsetY_) {}
+
+AffineTransform::AffineTransform(cv::Mat const& matrix) {
+    if (matrix.rows != 2 || matrix.cols != 3) throw std::invalid_argument("An affine transform takes a 2x3 matrix.");
+    cv::Mat m;
+    matrix.convertTo(m, CV_64F);
+
+    a_ = m.at<double>(0, 0), b_ = m.at<double>(0, 1), tx_ = m.at<double>(0, 2);
+    c_ = m.at<double>(1, 0), d_ = m.at<double>(1, 1), ty_ = m.at<double>(1, 2);
+}
+
+AffineTransform AffineTransform::rotation(cv::Point2d const& center, double angleInDegree) {
+    double angle = angleInDegree * CV_PI / 180;
+    double alpha = std::cos(angle);
+    double beta = std::sin(angle);
+    return AffineTransform(alpha, beta, (1 - alpha) * center.x - beta * center.y,
+                           -beta, alpha, beta * center.x + (1 - alpha) * center.y);
+}
+
+AffineTransform AffineTransform::translation(double offsetX, double offsetY) {
+    return AffineTransform(1, 0, offsetX, 0, 1, offsetY);
+}
+
+cv::Mat AffineTransform::matrix() const {
+    cv::Mat m(2, 3, CV_64F);
+    m.at<double>(0, 0) = a_, m.at<double>(0, 1) = b_, m.at<double>(0, 2) = tx_;
+    m.at<double>(1, 0) = c_, m.at<double>(1, 1) = d_, m.at<double>(1, 2) = ty_;
+    return m;
+}
+
+cv::Point2d AffineTransform::apply(cv::Point2d const& point) const {
+    return cv::Point2d(a_ * point.x + b_ * point.y + tx_,
+                       c_ * point.x + d_ * point.y + ty_);
+}
+
+cv::Point AffineTransform::apply(cv::Point const& point) const {
+    cv::Point2d mapped = apply(cv::Point2d(point.x, point.y));
+    return cv::Point(static_cast<int>(std::round(mapped.x)),
+                     static_cast<int>(std::round(mapped.y)));
+}
+
+cv::Rect AffineTransform::apply(cv::Rect const& rect) const {
+    cv::Rect mapped;
+    apply(&rect, &mapped, 1);
+    return mapped;
+}
+
+void AffineTransform::apply(cv::Rect const* src, cv::Rect* dst, size_t n) const {
+    // the corner a box is mapped to its minimum from depends only on the signs of the linear part
+    double loA = std::min(a_, 0.0), loB = std::min(b_, 0.0);
+    double loC = std::min(c_, 0.0), loD = std::min(d_, 0.0);
+    double absA = std::abs(a_), absB = std::abs(b_);
+    double absC = std::abs(c_), absD = std::abs(d_);
+
+    // branch-free so that the loop is vectorized, the coordinates are only rounded once at the end
+    for (size_t i = 0; i < n; ++i) {
+        double x = src[i].x, y = src[i].y;
+        double w = src[i].width, h = src[i].height;
+
+        double minX = a_ * x + b_ * y + tx_ + loA * w + loB * h;
+        double minY = c_ * x + d_ * y + ty_ + loC * w + loD * h;
+        double extentX = absA * w + absB * h;
+        double extentY = absC * w + absD * h;
+
+        dst[i] = cv::Rect(static_cast<int>(std::round(minX)),
+                          static_cast<int>(std::round(minY)),
+                          static_cast<int>(std::round(extentX)),
+                          static_cast<int>(std::round(extentY)));
+    }
+}
+
+AffineTransform& AffineTransform::reverse() {
+    if (b_ == 0 && c_ == 0) {
+        // inverted in the same way as PerspectiveTransform, so that both agree exactly
+        a_ = 1.0 / a_;
+        d_ = 1.0 / d_;
+        tx_ *= -a_;
+        ty_ *= -d_;
+        return *this;
+    }
+
+    double det = a_ * d_ - b_ * c_;
+    double a = d_ / det, b = -b_ / det;
+    double c = -c_ / det, d = a_ / det;
+    double tx = -(a * tx_ + b * ty_);
+    double ty = -(c * tx_ + d * ty_);
+
+    *this = AffineTransform(a, b, tx, c, d, ty);
+    return *this;
+}
+
+AffineTransform AffineTransform::reversed() const {
+    AffineTransform copy = *this;
+    return copy.reverse();
+}
+
+// that is applied after this
+AffineTransform& AffineTransform::merge(AffineTransform const& that) {
+    *this = AffineTransform(that.a_ * a_ + that.b_ * c_, that.a_ * b_ + that.b_ * d_, that.a_ * tx_ + that.b_ * ty_ + that.tx_,
+                            that.c_ * a_ + that.d_ * c_, that.c_ * b_ + that.d_ * d_, that.c_ * tx_ + that.d_ * ty_ + that.ty_);
+    return *this;
+}
+
+AffineTransform AffineTransform::merged(AffineTransform const& that) const {
+    AffineTransform copy = *this;
+    return copy.merge(that);
+}
+
+std::ostream& operator<<(std::ostream& strm, AffineTransform const& obj) {
+    return strm << "matrix: {" << obj.a_ << ", " << obj.b_ << ", " << obj.tx_ << "; "
+                << obj.c_ << ", " << obj.d_ << ", " << obj.ty_ << "}";
+}
+
+} // end namespace cz
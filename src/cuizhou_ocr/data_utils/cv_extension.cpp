@@ -2,7 +2,9 @@
 // Created by Zhihao Liu on 4/26/18.
 //
 
+#include <stdexcept>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
 #include "data_utils/cv_extension.h"
 
 
@@ -21,35 +23,124 @@ cv::Mat imgResizeAndFill(cv::Mat const& img,
                                    PerspectiveTransform* pForwardTransform) {
     if (img.cols == newWidth && img.rows == newHeight) return img.clone();
 
-    cv::Mat newImg(newHeight, newWidth, CV_8UC3, cv::Scalar(0, 0, 0));;
-    float wScale = static_cast<float>(newWidth) / img.cols;
-    float hScale = static_cast<float>(newHeight) / img.rows;
+    cv::Mat newImg(newHeight, newWidth, img.type());
+    imgResizeAndFill(img, newImg, pForwardTransform);
 
-    float unifiedScale = wScale < hScale ? wScale : hScale;
+    return newImg;
+}
 
-    cv::Mat tempImg;
-    cv::resize(img, tempImg, cv::Size(static_cast<int>(unifiedScale * img.cols), static_cast<int>(unifiedScale * img.rows)));
+// resize the image into dst, which is usually a sub-matrix of a larger canvas, while preserving its width-height ratio
+// the resized pixels are written in place and only the letterbox borders around them are zeroed
+void imgResizeAndFill(cv::Mat const& img, cv::Mat& dst, PerspectiveTransform* pForwardTransform) {
+    // resize would silently reallocate a sub-matrix of another type and detach it from the canvas
+    if (img.type() != dst.type()) throw std::invalid_argument("Image and destination types mismatch.");
 
-    int xShift = (newImg.cols - tempImg.cols) / 2;
-    int yShift = (newImg.rows - tempImg.rows) / 2;
-    tempImg.copyTo(newImg(cv::Rect(xShift, yShift, tempImg.cols, tempImg.rows)));
+    float unifiedScale;
+    cv::Rect area = letterboxArea(img.size(), dst.size(), &unifiedScale);
+
+    // the header shares the data of dst, so that resize writes into it without reallocation
+    cv::Mat resizedArea = dst(area);
+    cv::resize(img, resizedArea, resizedArea.size());
+
+    fillLetterboxBorders(dst, area);
 
     if (pForwardTransform) {
-        pForwardTransform->setOffset(xShift, yShift);
+        pForwardTransform->setOffset(area.x, area.y);
         pForwardTransform->setScale(unifiedScale);
     }
+}
 
-    return newImg;
+// the centered area of dstSize an image of srcSize is resized into while preserving its width-height ratio
+cv::Rect letterboxArea(cv::Size const& srcSize, cv::Size const& dstSize, float* pScale) {
+    float wScale = static_cast<float>(dstSize.width) / srcSize.width;
+    float hScale = static_cast<float>(dstSize.height) / srcSize.height;
+
+    float unifiedScale = wScale < hScale ? wScale : hScale;
+    if (pScale) *pScale = unifiedScale;
+
+    int resizedWidth = static_cast<int>(unifiedScale * srcSize.width);
+    int resizedHeight = static_cast<int>(unifiedScale * srcSize.height);
+    int xShift = (dstSize.width - resizedWidth) / 2;
+    int yShift = (dstSize.height - resizedHeight) / 2;
+
+    return cv::Rect(xShift, yShift, resizedWidth, resizedHeight);
+}
+
+// zero everything of dst outside the area
+void fillLetterboxBorders(cv::Mat& dst, cv::Rect const& area) {
+    cv::Scalar black(0, 0, 0);
+    dst.rowRange(0, area.y).setTo(black);
+    dst.rowRange(area.y + area.height, dst.rows).setTo(black);
+    dst(cv::Rect(0, area.y, area.x, area.height)).setTo(black);
+    dst(cv::Rect(area.x + area.width, area.y, dst.cols - area.x - area.width, area.height)).setTo(black);
 }
 
 cv::Mat imgRotate(cv::Mat const& img, double angleInDegree) {
     cv::Mat newImg;
+    imgRotate(img, newImg, angleInDegree);
+    return newImg;
+}
 
+// dst is reused if it already has the size and type of img, it must not share data with img
+void imgRotate(cv::Mat const& img, cv::Mat& dst, double angleInDegree) {
     cv::Point2d pt(img.cols / 2.0, img.rows / 2.0);
     cv::Mat r = cv::getRotationMatrix2D(pt, angleInDegree, 1.0);
-    cv::warpAffine(img, newImg, r, img.size());
+    cv::warpAffine(img, dst, r, img.size());
+}
 
-    return newImg;
+// read the frame size from the SOF segment of a JPEG stream without decoding it
+// an empty size is returned if the data is not a JPEG stream or is truncated before the frame header
+cv::Size readJpegSize(uint8_t const* data, size_t size) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return cv::Size();
+
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return cv::Size();
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) { // fill byte
+            ++pos;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD9)) { // standalone markers
+            pos += 2;
+            continue;
+        }
+
+        size_t length = (data[pos + 2] << 8) | data[pos + 3];
+        bool isSof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (isSof) {
+            if (pos + 9 > size) return cv::Size();
+            int height = (data[pos + 5] << 8) | data[pos + 6];
+            int width = (data[pos + 7] << 8) | data[pos + 8];
+            return cv::Size(width, height);
+        }
+        pos += 2 + length;
+    }
+    return cv::Size();
+}
+
+// the imdecode flag that lets the JPEG decoder downscale in the DCT domain by the largest factor of 1/2, 1/4 or 1/8
+// for which the letterboxing of the decoded image into targetSize is still a downscaling
+int reducedDecodeFlag(cv::Size const& srcSize, cv::Size const& targetSize) {
+    if (srcSize.area() == 0 || targetSize.area() == 0) return cv::IMREAD_COLOR;
+
+    double wRatio = static_cast<double>(srcSize.width) / targetSize.width;
+    double hRatio = static_cast<double>(srcSize.height) / targetSize.height;
+    double maxFactor = wRatio < hRatio ? wRatio : hRatio;
+
+    if (maxFactor >= 8) return cv::IMREAD_REDUCED_COLOR_8;
+    if (maxFactor >= 4) return cv::IMREAD_REDUCED_COLOR_4;
+    if (maxFactor >= 2) return cv::IMREAD_REDUCED_COLOR_2;
+    return cv::IMREAD_COLOR;
+}
+
+// decode an encoded image into dst at the smallest scale that can still be letterboxed into targetSize without upscaling
+// streams other than JPEG, and any stream if targetSize is empty, are decoded at full resolution
+void imgDecodeForSize(uint8_t const* data, size_t size, cv::Size const& targetSize, cv::Mat& dst) {
+    // the header wraps the encoded bytes without copying them
+    cv::Mat buf(1, static_cast<int>(size), CV_8UC1, const_cast<uint8_t*>(data));
+    int flag = reducedDecodeFlag(readJpegSize(data, size), targetSize);
+    cv::imdecode(buf, flag, &dst);
 }
 
 cv::Rect extent(cv::Mat const& img) {
@@ -19,8 +19,12 @@ LinearFit::LinearFit(std::vector<double> const& x, std::vector<double> const& y)
         t4 += y[i];
     }
 
-    a = (t3 * x.size() - t2 * t4) / (t1 * x.size() - t2 * t2);
-    b = (t1 * t4 - t2 * t3) / (t1 * x.size() - t2 * t2);
+    *this = LinearFit(t1, t2, t3, t4, x.size());
+}
+
+LinearFit::LinearFit(double sumXX, double sumX, double sumXY, double sumY, size_t n) {
+    a = (sumXY * n - sumX * sumY) / (sumXX * n - sumX * sumX);
+    b = (sumXX * sumY - sumX * sumXY) / (sumXX * n - sumX * sumX);
 }
 
 double LinearFit::slope() const {
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "data_utils/image_source.h"
+#include "data_utils/cv_extension.h"
+#include "metrics.h"
+#include "tracing.h"
+
+
+namespace cz {
+
+namespace {
+
+bool readLine(std::istream& strm, std::string& path) {
+    while (std::getline(strm, path)) {
+        if (!path.empty() && path.back() == '\r') path.pop_back();
+        if (!path.empty()) return true;
+    }
+    return false;
+}
+
+bool readFile(std::string const& path, std::vector<uint8_t>& bytes) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+
+    bytes.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), bytes.size()));
+}
+
+} // end namespace
+
+PathReader readDirectory(std::string const& dirPath) {
+    auto paths = std::make_shared<std::vector<std::string>>();
+
+    DIR* dir = opendir(dirPath.c_str());
+    if (dir) {
+        while (dirent* de = readdir(dir)) {
+            std::string path = dirPath + "/" + de->d_name;
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) paths->push_back(std::move(path));
+        }
+        closedir(dir);
+    }
+    std::sort(paths->begin(), paths->end());
+
+    size_t next = 0;
+    return [paths, next](std::string& path) mutable {
+        if (next == paths->size()) return false;
+        path = (*paths)[next++];
+        return true;
+    };
+}
+
+PathReader readPathList(std::string const& listPath) {
+    auto file = std::make_shared<std::ifstream>(listPath);
+    return [file](std::string& path) { return readLine(*file, path); };
+}
+
+PathReader readPathStream(std::istream& strm) {
+    return [&strm](std::string& path) { return readLine(strm, path); };
+}
+
+double ImageSourceStats::meanQueueDepth() const {
+    return numTaken > 0 ? static_cast<double>(sumQueueDepth) / numTaken : 0;
+}
+
+ImageSource::~ImageSource() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    notFull_.notify_all();
+    notEmpty_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+ImageSource::ImageSource(PathReader readPath, int numThreads, size_t capacity, cv::Size const& targetSize)
+        : readPath_(std::move(readPath)), targetSize_(targetSize), capacity_(std::max<size_t>(capacity, 1)) {
+    numThreads = std::max(numThreads, 1);
+    numRunning_ = numThreads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads_.emplace_back(&ImageSource::run, this);
+    }
+}
+
+bool ImageSource::take(SourceImage& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t depth = queue_.size();
+
+    if (queue_.empty() && numRunning_ > 0) {
+        static metrics::Counter& starved = metrics::counter("cz_source_starved_total", "Takes of an image source that waited for a decode.");
+        if (metrics::isEnabled()) starved.add(1);
+
+        uint64_t waitStartUs = tracing::nowUs();
+        ++stats_.numStarved;
+        notEmpty_.wait(lock, [this] { return !queue_.empty() || numRunning_ == 0; });
+        stats_.starvedMs += (tracing::nowUs() - waitStartUs) / 1000.0;
+    }
+    if (queue_.empty()) return false;
+
+    ++stats_.numTaken;
+    stats_.sumQueueDepth += depth;
+    item = std::move(queue_.front());
+    queue_.pop_front();
+    notFull_.notify_one();
+    return true;
+}
+
+ImageSourceStats ImageSource::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+bool ImageSource::nextPath(SourceImage& item) {
+    std::lock_guard<std::mutex> lock(pathMutex_);
+    if (!readPath_(item.path)) return false;
+    item.index = nextIndex_++;
+    return true;
+}
+
+void ImageSource::run() {
+    static metrics::Histogram& decodeDurations = metrics::histogram("cz_source_decode_us", "Reading and decoding time per image in microseconds.");
+    std::vector<uint8_t> bytes; // reused by the images of this thread
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) break;
+        }
+
+        SourceImage item;
+        if (!nextPath(item)) break;
+
+        uint64_t decodeStartUs = tracing::nowUs();
+        if (readFile(item.path, bytes) && !bytes.empty()) {
+            imgDecodeForSize(bytes.data(), bytes.size(), targetSize_, item.image);
+        }
+        uint64_t decodeUs = tracing::nowUs() - decodeStartUs;
+        item.decodeMs = decodeUs / 1000.0;
+        if (metrics::isEnabled()) decodeDurations.record(decodeUs);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (item.image.empty()) ++stats_.numFailed;
+        else ++stats_.numDecoded;
+        stats_.decodeMs += item.decodeMs;
+
+        if (queue_.size() >= capacity_) {
+            ++stats_.numBlocked;
+            notFull_.wait(lock, [this] { return queue_.size() < capacity_ || stopping_; });
+        }
+        if (stopping_) break;
+
+        queue_.push_back(std::move(item));
+        stats_.maxQueueDepth = std::max(stats_.maxQueueDepth, static_cast<long>(queue_.size()));
+        notEmpty_.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --numRunning_;
+    }
+    notEmpty_.notify_all();
+}
+
+} // end namespace cz
@@ -0,0 +1,101 @@
+#include <stdexcept>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "data_utils/raw_frame.h"
+#include "data_utils/cv_extension.h"
+
+
+namespace cz {
+
+namespace {
+
+cv::Mat wrapPlane(RawFrame const& frame, int rows, int cols, int type, int rowOffset = 0) {
+    uint8_t* data = const_cast<uint8_t*>(frame.data) + rowOffset * frame.stride;
+    return cv::Mat(rows, cols, type, data, frame.stride);
+}
+
+} // end namespace
+
+// convert the frame into a BGR image at its own resolution
+void imgFromRawFrame(RawFrame const& frame, cv::Mat& dst) {
+    switch (frame.format) {
+        case PixelFormat::BGR: wrapPlane(frame, frame.height, frame.width, CV_8UC3).copyTo(dst); break;
+        case PixelFormat::BGRA: cv::cvtColor(wrapPlane(frame, frame.height, frame.width, CV_8UC4), dst, cv::COLOR_BGRA2BGR); break;
+        case PixelFormat::GRAY: cv::cvtColor(wrapPlane(frame, frame.height, frame.width, CV_8UC1), dst, cv::COLOR_GRAY2BGR); break;
+        case PixelFormat::NV12: cv::cvtColor(wrapPlane(frame, frame.height * 3 / 2, frame.width, CV_8UC1), dst, cv::COLOR_YUV2BGR_NV12); break;
+        case PixelFormat::YUYV: cv::cvtColor(wrapPlane(frame, frame.height, frame.width, CV_8UC2), dst, cv::COLOR_YUV2BGR_YUYV); break;
+        default: throw std::invalid_argument("Pixel format unsupported.");
+    }
+}
+
+// letterbox the frame into dst, which must be allocated as CV_8UC3, converting it into BGR on the way
+// the frame is resized in its native format into scratch first, so that color conversion runs at the size of dst
+// and no BGR image of the input resolution is ever materialized
+void imgResizeAndFill(RawFrame const& frame, cv::Mat& dst, cv::Mat& scratch, PerspectiveTransform* pForwardTransform) {
+    float unifiedScale;
+    cv::Rect area = letterboxArea(cv::Size(frame.width, frame.height), dst.size(), &unifiedScale);
+
+    // chroma is subsampled horizontally by both YUV formats and vertically by NV12
+    bool isYuv = frame.format == PixelFormat::NV12 || frame.format == PixelFormat::YUYV;
+    if (isYuv) {
+        area.width -= area.width % 2;
+        area.height -= area.height % 2;
+    }
+
+    cv::Mat resizedArea = dst(area);
+    int w = area.width, h = area.height;
+    switch (frame.format) {
+        case PixelFormat::BGR: {
+            cv::resize(wrapPlane(frame, frame.height, frame.width, CV_8UC3), resizedArea, resizedArea.size());
+        } break;
+
+        case PixelFormat::BGRA: {
+            cv::resize(wrapPlane(frame, frame.height, frame.width, CV_8UC4), scratch, area.size());
+            cv::cvtColor(scratch, resizedArea, cv::COLOR_BGRA2BGR);
+        } break;
+
+        case PixelFormat::GRAY: {
+            cv::resize(wrapPlane(frame, frame.height, frame.width, CV_8UC1), scratch, area.size());
+            cv::cvtColor(scratch, resizedArea, cv::COLOR_GRAY2BGR);
+        } break;
+
+        case PixelFormat::NV12: {
+            // both planes are resized into one contiguous NV12 image of the target size
+            scratch.create(h * 3 / 2, w, CV_8UC1);
+            cv::Mat lumaResized = scratch.rowRange(0, h);
+            cv::Mat chromaResized(h / 2, w / 2, CV_8UC2, scratch.ptr(h), scratch.step[0]);
+            cv::resize(wrapPlane(frame, frame.height, frame.width, CV_8UC1), lumaResized, lumaResized.size());
+            cv::resize(wrapPlane(frame, frame.height / 2, frame.width / 2, CV_8UC2, frame.height), chromaResized, chromaResized.size());
+            cv::cvtColor(scratch, resizedArea, cv::COLOR_YUV2BGR_NV12);
+        } break;
+
+        case PixelFormat::YUYV: {
+            // luma is resized at full width from the Y channel of the 2-byte pixels, chroma at half width
+            // from the U and V channels of the 4-byte Y0 U Y1 V pixels, the other channels of each are dropped
+            // the two are then interleaved into one YUYV image of the target size
+            scratch.create(h * 3, w * 2, CV_8UC1);
+            cv::Mat packed(h, w, CV_8UC2, scratch.ptr(0), scratch.step[0]);
+            cv::Mat packedQuads(h, w / 2, CV_8UC4, scratch.ptr(0), scratch.step[0]);
+            cv::Mat lumaResized(h, w, CV_8UC2, scratch.ptr(h), scratch.step[0]);
+            cv::Mat chromaResized(h, w / 2, CV_8UC4, scratch.ptr(h * 2), scratch.step[0]);
+            cv::resize(wrapPlane(frame, frame.height, frame.width, CV_8UC2), lumaResized, lumaResized.size());
+            cv::resize(wrapPlane(frame, frame.height, frame.width / 2, CV_8UC4), chromaResized, chromaResized.size());
+
+            int const lumaFromTo[] = {0, 0};
+            int const chromaFromTo[] = {1, 1, 3, 3};
+            cv::mixChannels(&lumaResized, 1, &packed, 1, lumaFromTo, 1);
+            cv::mixChannels(&chromaResized, 1, &packedQuads, 1, chromaFromTo, 2);
+            cv::cvtColor(packed, resizedArea, cv::COLOR_YUV2BGR_YUYV);
+        } break;
+
+        default: throw std::invalid_argument("Pixel format unsupported.");
+    }
+
+    fillLetterboxBorders(dst, area);
+
+    if (pForwardTransform) {
+        pForwardTransform->setOffset(area.x, area.y);
+        pForwardTransform->setScale(unifiedScale);
+    }
+}
+
+} // end namespace cz
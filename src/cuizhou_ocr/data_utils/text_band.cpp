@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "data_utils/text_band.h"
+
+
+namespace cz {
+
+TextBand locateTextBand(cv::Mat const& img, TextBandParams const& params) {
+    std::vector<int> rowEnergy;
+    computeRowEdgeEnergy(img, rowEnergy);
+    return locateTextBand(rowEnergy, img.cols, params);
+}
+
+TextBand locateTextBand(std::vector<int> const& rowEnergy, int width, TextBandParams const& params) {
+    int rows = static_cast<int>(rowEnergy.size());
+    int radius = params.lineRadius;
+
+    std::vector<long> energy(rowEnergy.cbegin(), rowEnergy.cend());
+    std::vector<long> prefix(rows + 1, 0);
+    std::vector<int> lines;
+
+    // the strongest window is taken as a line, and its rows are cleared before the next line is searched
+    for (int k = 0; k < params.numLines; ++k) {
+        for (int i = 0; i < rows; ++i) {
+            prefix[i + 1] = prefix[i] + energy[i];
+        }
+
+        long mostSum = 0;
+        int lineY = -1;
+        for (int i = radius; i < rows - radius; i += radius) {
+            long sum = prefix[i + radius + 1] - prefix[i - radius];
+            if (sum > mostSum) {
+                mostSum = sum;
+                lineY = i;
+            }
+        }
+        if (lineY < 0) break; // no edges are left
+
+        lines.push_back(lineY);
+        std::fill(energy.begin() + (lineY - radius), energy.begin() + (lineY + radius + 1), 0);
+    }
+
+    TextBand band;
+    if (lines.empty()) return band;
+
+    std::sort(lines.begin(), lines.end());
+    size_t mid = lines.size() / 2;
+    int centerY = lines.size() % 2 ? lines[mid] : (lines[mid - 1] + lines[mid]) / 2;
+
+    int bandRadius = static_cast<int>(rows * params.bandRadiusRatio);
+    int top = std::max(centerY - bandRadius, 0);
+    int bot = std::min(centerY + bandRadius, rows - 1);
+    band.rect = cv::Rect(0, top, width, bot - top + 1);
+
+    long totalEnergy = 0, bandEnergy = 0;
+    for (int i = 0; i < rows; ++i) {
+        totalEnergy += rowEnergy[i];
+        if (i >= top && i <= bot) bandEnergy += rowEnergy[i];
+    }
+    band.confidence = totalEnergy > 0 ? static_cast<double>(bandEnergy) / totalEnergy : 0;
+    return band;
+}
+
+void computeRowEdgeEnergy(cv::Mat const& img, std::vector<int>& rowEnergy) {
+    cv::Mat gray;
+    if (img.channels() == 3) {
+        cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        gray = img;
+    }
+
+    cv::Mat edges;
+    cv::GaussianBlur(gray, edges, cv::Size(3, 3), 0.51);
+    cv::Canny(edges, edges, 250, 100);
+
+    // edges are 0 or 255, so the sum of a row fits in an int for any practical width
+    cv::Mat sums;
+    cv::reduce(edges, sums, 1, cv::REDUCE_SUM, CV_32S);
+    rowEnergy.assign(sums.ptr<int>(), sums.ptr<int>() + sums.rows);
+}
+
+} // end namespace cz
@@ -11,10 +11,72 @@
 
 namespace cz {
 
+namespace {
+
+size_t const MAX_STACK_CHARS = 64;
+
+// rectAt(i) is the rect of the i-th of the n characters
+template<typename RectAt>
+CharLineSummary summarizeCharLine(size_t n, RectAt rectAt) {
+    CharLineSummary summary;
+    summary.numChars = static_cast<int>(n);
+    if (n == 0) return summary;
+
+    // scratch for the three medians, on the stack unless the line is unusually long
+    int stackScratch[3 * MAX_STACK_CHARS];
+    std::vector<int> heapScratch;
+    int* heights = stackScratch;
+    if (n > MAX_STACK_CHARS) {
+        heapScratch.resize(3 * n);
+        heights = heapScratch.data();
+    }
+    int* yMids = heights + n;
+    int* spacings = yMids + n;
+
+    double sumXX = 0, sumX = 0, sumXY = 0, sumY = 0;
+    int xMidPrev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        cv::Rect rect = rectAt(i);
+        int x = xMid(rect);
+        int y = yMid(rect);
+
+        sumXX += static_cast<double>(x) * x;
+        sumX += x;
+        sumXY += static_cast<double>(x) * y;
+        sumY += y;
+
+        heights[i] = rect.height;
+        yMids[i] = y;
+        if (i > 0) spacings[i - 1] = std::abs(x - xMidPrev);
+        xMidPrev = x;
+    }
+
+    summary.slope = LinearFit(sumXX, sumX, sumXY, sumY, n).slope();
+    summary.height = selectKth(heights, n, n / 2);
+    summary.yMid = selectKth(yMids, n, n / 2);
+    if (n >= 2) summary.spacing = selectKth(spacings, n - 1, (n - 1) / 2);
+    return summary;
+}
+
+} // end anonymous namespace
+
 bool isNumbericChar(std::string const& str) {
     return str.length() == 1 && str[0] >= '0' && str[0] <= '9';
 }
 
+CharClasses resolveCharClasses(LabelTable const& labels) {
+    CharClasses chars;
+    for (int i = 0; i < labels.size(); ++i) {
+        std::string const& label = labels[i];
+        chars.isNumeric.push_back(isNumbericChar(label));
+        if (label == "1") chars.one = i;
+        else if (label == "4") chars.four = i;
+        else if (label == "7") chars.seven = i;
+        else if (label == "H") chars.letterH = i;
+    }
+    return chars;
+}
+
 std::vector<std::string> readClassNames(std::string const& path, bool addBackground) {
     std::ifstream file(path);
     std::vector<std::string> classNames;
@@ -49,6 +111,13 @@ bool isSortedByXMid(std::vector<Detection> const& dets) {
     });
 }
 
+bool isSortedByXMid(DetectionSet const& dets) {
+    for (size_t i = 1; i < dets.size(); ++i) {
+        if (xMid(dets.rect(i)) < xMid(dets.rect(i - 1))) return false;
+    }
+    return true;
+}
+
 OcrDetection joinDetections(std::vector<Detection> const& dets) {
     std::string text = joinDetectedChars(dets);
     cv::Rect rect = computeExtent(dets);
@@ -65,6 +134,21 @@ std::string joinDetectedChars(std::vector<Detection> const& dets) {
     return result;
 }
 
+// labels are only looked up here, once the detections are final
+OcrDetection joinDetections(DetectionSet const& dets) {
+    return OcrDetection(joinDetectedChars(dets), dets.extent());
+}
+
+std::string joinDetectedChars(DetectionSet const& dets) {
+    assert(isSortedByXMid(dets));
+
+    std::string result;
+    for (size_t i = 0; i < dets.size(); ++i) {
+        result.append(dets.label(i));
+    }
+    return result;
+}
+
 void eliminateLetters(std::vector<Detection>& dets) {
     dets.erase(std::remove_if(dets.begin(), dets.end(),
                               [](Detection const& det) { return !isNumbericChar(det.label); }),
@@ -75,8 +159,9 @@ void eliminateYOutliers(std::vector<Detection>& dets, float thresh) {
     if (dets.size() < 3) return;
 
     // remove those lies off the horizontal reference line
-    int heightRef = findMedian(dets, [](Detection const& det) { return det.rect.height; });
-    int yMidRef = findMedian(dets, [](Detection const& det) { return yMid(det.rect); });
+    CharLineSummary summary = summarizeCharLine(dets);
+    int heightRef = summary.height;
+    int yMidRef = summary.yMid;
 
     dets.erase(std::remove_if(dets.begin(), dets.end(),
                               [&](Detection const& det) {
@@ -85,6 +170,33 @@ void eliminateYOutliers(std::vector<Detection>& dets, float thresh) {
                dets.end());
 }
 
+void eliminateLetters(DetectionSet& dets, CharClasses const& chars) {
+    std::vector<size_t> kept;
+    for (size_t i = 0; i < dets.size(); ++i) {
+        if (chars.isNumeric[dets.classId(i)]) kept.push_back(i);
+    }
+    dets.select(kept);
+}
+
+void eliminateYOutliers(DetectionSet& dets, float thresh) {
+    if (dets.size() < 3) return;
+
+    CharLineSummary summary = summarizeCharLine(dets);
+    std::vector<size_t> kept;
+    for (size_t i = 0; i < dets.size(); ++i) {
+        if (std::abs(yMid(dets.rect(i)) - summary.yMid) <= thresh * summary.height) kept.push_back(i);
+    }
+    dets.select(kept);
+}
+
+CharLineSummary summarizeCharLine(std::vector<Detection> const& dets) {
+    return summarizeCharLine(dets.size(), [&](size_t i) { return dets[i].rect; });
+}
+
+CharLineSummary summarizeCharLine(DetectionSet const& dets) {
+    return summarizeCharLine(dets.size(), [&](size_t i) { return dets.rect(i); });
+}
+
 cv::Rect computeExtent(std::vector<Detection> const& dets) {
     if (dets.empty()) return cv::Rect();
 
@@ -97,28 +209,26 @@ cv::Rect computeExtent(std::vector<Detection> const& dets) {
 
 double estimateCharAlignmentSlope(std::vector<Detection> const& dets) {
     if (dets.empty()) return 0;
-
-    std::vector<double> xCoords, yCoords;
-    std::transform(dets.cbegin(), dets.cend(), std::back_inserter(xCoords),
-                   [](Detection det) { return xMid(det.rect); });
-    std::transform(dets.cbegin(), dets.cend(), std::back_inserter(yCoords),
-                   [](Detection det) { return yMid(det.rect); });
-
-    LinearFit lf(xCoords, yCoords);
-    return lf.slope();
+    return summarizeCharLine(dets).slope;
 }
 
 int estimateCharSpacing(std::vector<Detection> const& dets) {
     if (dets.size() < 2) return 0;
     assert(isSortedByXMid(dets));
 
-    std::vector<int> spacings;
-    for (auto itr = std::next(dets.cbegin()); itr != dets.cend(); ++itr) {
-        int spacing = computeSpacing(std::prev(itr)->rect, itr->rect);
-        spacings.push_back(spacing);
-    }
+    return summarizeCharLine(dets).spacing;
+}
+
+double estimateCharAlignmentSlope(DetectionSet const& dets) {
+    if (dets.empty()) return 0;
+    return summarizeCharLine(dets).slope;
+}
+
+int estimateCharSpacing(DetectionSet const& dets) {
+    if (dets.size() < 2) return 0;
+    assert(isSortedByXMid(dets));
 
-    return findMedian(spacings);
+    return summarizeCharLine(dets).spacing;
 }
 
 void shrinkRectToExtent(cv::Rect& rect, cv::Rect const& extentInRect) {
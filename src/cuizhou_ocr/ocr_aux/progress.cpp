@@ -0,0 +1,59 @@
+#include "ocr_aux/progress.h"
+
+
+namespace cz {
+
+char const* stageName(ProcessStage stage) {
+    switch (stage) {
+        case ProcessStage::STANDARDIZE: return "standardize";
+        case ProcessStage::LOCATE_TEXT_BAND: return "locate_text_band";
+        case ProcessStage::DETECT_KEYS: return "detect_keys";
+        case ProcessStage::ROTATION_PROBE: return "rotation_probe";
+        case ProcessStage::ROTATE: return "rotate";
+        case ProcessStage::VIN_ROUND_1: return "vin_round_1";
+        case ProcessStage::VIN_ROUND_2: return "vin_round_2";
+        case ProcessStage::VIN_ROUND_3: return "vin_round_3";
+        case ProcessStage::GAPS: return "gaps";
+        case ProcessStage::CLASSIFY: return "classify";
+        case ProcessStage::COLLAGE_PASS_1: return "collage_pass_1";
+        case ProcessStage::COLLAGE_PASS_2: return "collage_pass_2";
+        default: return "unknown";
+    }
+}
+
+double ProgressEvent::inputPixelsPerForward() const {
+    return numForwards > 0 ? static_cast<double>(numInputPixels) / numForwards : 0;
+}
+
+void StageStats::add(ProgressEvent const& event) {
+    Totals& totals = totals_[static_cast<int>(event.stage)];
+    ++totals.numEvents;
+    totals.wallMs += event.wallMs;
+    totals.cpuMs += event.cpuMs;
+    totals.numForwards += event.numForwards;
+    totals.numInputPixels += event.numInputPixels;
+    totals.numDetections += event.numDetections;
+}
+
+void StageStats::clear() {
+    totals_.fill(Totals());
+}
+
+StageStats::Totals const& StageStats::operator[](ProcessStage stage) const {
+    return totals_[static_cast<int>(stage)];
+}
+
+StageStats::Totals StageStats::total() const {
+    Totals sum;
+    for (Totals const& totals : totals_) {
+        sum.numEvents += totals.numEvents;
+        sum.wallMs += totals.wallMs;
+        sum.cpuMs += totals.cpuMs;
+        sum.numForwards += totals.numForwards;
+        sum.numInputPixels += totals.numInputPixels;
+        sum.numDetections += totals.numDetections;
+    }
+    return sum;
+}
+
+} // end namespace cz
@@ -0,0 +1,84 @@
+#include "ocr_aux/tile_grid.h"
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+
+namespace cz {
+
+TileGrid::~TileGrid() = default;
+
+TileGrid::TileGrid() = default;
+
+TileGrid::TileGrid(std::vector<cv::Rect> const& tiles) {
+    int minWidth = 0, minHeight = 0;
+    for (auto const& tile : tiles) {
+        if (tile.area() <= 0) continue;
+        extent_ = extent_.area() > 0 ? (extent_ | tile) : tile;
+        minWidth = minWidth > 0 ? std::min(minWidth, tile.width) : tile.width;
+        minHeight = minHeight > 0 ? std::min(minHeight, tile.height) : tile.height;
+    }
+    if (extent_.area() <= 0) return;
+
+    // cells about the size of the smallest tile, so that a rect of that size falls into a few of them
+    auto ceilDiv = [](int a, int b) { return (a + b - 1) / b; };
+    cellSize_ = cv::Size(std::max(minWidth, ceilDiv(extent_.width, MAX_CELLS_PER_SIDE)),
+                         std::max(minHeight, ceilDiv(extent_.height, MAX_CELLS_PER_SIDE)));
+    numCols_ = ceilDiv(extent_.width, cellSize_.width);
+    numRows_ = ceilDiv(extent_.height, cellSize_.height);
+
+    // count the tiles of each cell, then fill them in, tiles are visited in ascending order in both passes
+    cellStarts_.assign(numCols_ * numRows_ + 1, 0);
+    for (auto const& tile : tiles) {
+        if (tile.area() <= 0) continue;
+        cv::Rect cells = cellRange(tile);
+        for (int row = cells.y; row < cells.br().y; ++row) {
+            for (int col = cells.x; col < cells.br().x; ++col) {
+                ++cellStarts_[row * numCols_ + col + 1];
+            }
+        }
+    }
+    std::partial_sum(cellStarts_.cbegin(), cellStarts_.cend(), cellStarts_.begin());
+
+    cellTiles_.resize(cellStarts_.back());
+    std::vector<int> cursors(cellStarts_.cbegin(), std::prev(cellStarts_.cend()));
+    for (int i = 0; i < tiles.size(); ++i) {
+        if (tiles[i].area() <= 0) continue;
+        cv::Rect cells = cellRange(tiles[i]);
+        for (int row = cells.y; row < cells.br().y; ++row) {
+            for (int col = cells.x; col < cells.br().x; ++col) {
+                cellTiles_[cursors[row * numCols_ + col]++] = i;
+            }
+        }
+    }
+}
+
+void TileGrid::query(cv::Rect const& rect, std::vector<int>& candidates) const {
+    candidates.clear();
+    if (numCols_ == 0 || (rect & extent_).area() <= 0) return;
+
+    cv::Rect cells = cellRange(rect & extent_);
+    for (int row = cells.y; row < cells.br().y; ++row) {
+        for (int col = cells.x; col < cells.br().x; ++col) {
+            int cell = row * numCols_ + col;
+            candidates.insert(candidates.end(), cellTiles_.cbegin() + cellStarts_[cell], cellTiles_.cbegin() + cellStarts_[cell + 1]);
+        }
+    }
+
+    // a rect within a single cell already yields sorted and unique indices
+    if (cells.area() > 1) {
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+}
+
+// the range of cells covered by a non-empty rect within the extent
+cv::Rect TileGrid::cellRange(cv::Rect const& rect) const {
+    int col0 = (rect.x - extent_.x) / cellSize_.width;
+    int row0 = (rect.y - extent_.y) / cellSize_.height;
+    int col1 = (rect.br().x - 1 - extent_.x) / cellSize_.width;
+    int row1 = (rect.br().y - 1 - extent_.y) / cellSize_.height;
+    return cv::Rect(cv::Point(col0, row0), cv::Point(col1 + 1, row1 + 1));
+}
+
+} // end namespace cz
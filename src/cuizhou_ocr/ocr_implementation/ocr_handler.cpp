@@ -2,25 +2,208 @@
 // Created by Zhihao Liu on 18-4-4.
 //
 
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
 #include "ocr_implementation/ocr_handler.h"
+#include "data_utils/cv_extension.h"
 
 
 namespace cz {
 
+namespace {
+
+double wallClockMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double threadCpuMs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+metrics::Histogram& stageDurationHistogram(ProcessStage stage) {
+    static std::array<metrics::Histogram*, NUM_PROCESS_STAGES> const histograms = [] {
+        std::array<metrics::Histogram*, NUM_PROCESS_STAGES> result;
+        for (int i = 0; i < NUM_PROCESS_STAGES; ++i) {
+            std::string labels = std::string("stage=\"") + stageName(static_cast<ProcessStage>(i)) + "\"";
+            result[i] = &metrics::histogram("cz_ocr_stage_duration_us", "Duration of processing stages in microseconds.", labels);
+        }
+        return result;
+    }();
+    return *histograms[static_cast<int>(stage)];
+}
+
+} // end namespace
+
+OcrHandler::StageTimer::~StageTimer() {
+    if (!handler_) return;
+
+    event_.wallMs = wallClockMs() - wallMsStart_;
+    event_.cpuMs = threadCpuMs() - cpuMsStart_;
+    ForwardStats forwardStatsEnd = handler_->modelForwardStats();
+    event_.numForwards = forwardStatsEnd.numForwards - forwardStatsStart_.numForwards;
+    event_.numInputPixels = forwardStatsEnd.numInputPixels - forwardStatsStart_.numInputPixels;
+
+    handler_->reportProgress(event_);
+}
+
+OcrHandler::StageTimer::StageTimer(OcrHandler& handler, ProcessStage stage)
+        : traceScope_(stageName(stage)),
+          handler_(handler.isTimingStages() ? &handler : nullptr) {
+    event_.stage = stage;
+    if (!handler_) return;
+
+    forwardStatsStart_ = handler_->modelForwardStats();
+    wallMsStart_ = wallClockMs();
+    cpuMsStart_ = threadCpuMs();
+}
+
+void OcrHandler::StageTimer::setNumDetections(long numDetections) {
+    event_.numDetections = numDetections;
+}
+
 OcrHandler::~OcrHandler() = default;
 
 OcrHandler::OcrHandler() = default;
 
 void OcrHandler::importImage(cv::Mat const& image) {
-    image_ = image.clone();
+    if (importedFrame_.data == image.data) importedFrame_ = cv::Mat();
+    image.copyTo(importedFrame_);
+    updateImage(importedFrame_);
 }
 
 void OcrHandler::setImageSource(cv::Mat const& image) {
-    image_ = image;
+    updateImage(image);
+}
+
+void OcrHandler::importEncoded(uint8_t const* data, size_t size) {
+    imgDecodeForSize(data, size, standardSize(), importedFrame_);
+    if (importedFrame_.empty()) throw std::invalid_argument("Failed to decode the encoded image.");
+    updateImage(importedFrame_);
+}
+
+void OcrHandler::importFrame(RawFrame const& frame) {
+    cv::Size size = standardSize();
+    if (size.area() == 0) {
+        imgFromRawFrame(frame, importedFrame_);
+        updateImage(importedFrame_);
+        return;
+    }
+
+    // converted straight into the standardized buffer, so that standardizeImage() has nothing left to do
+    standardizedFrame_.create(size, CV_8UC3);
+    imgResizeAndFill(frame, standardizedFrame_, rawFrameScratch_);
+    updateImage(standardizedFrame_);
+}
+
+std::vector<std::string> OcrHandler::processImages(std::vector<cv::Mat> const& images, ShowProgress const& showProgress) {
+    std::vector<std::string> results;
+    for (auto const& image : images) {
+        setImageSource(image);
+        processImage(showProgress);
+        results.push_back(getResultAsString());
+    }
+    return results;
 }
 
 cv::Mat const& OcrHandler::image() const {
     return image_;
 }
 
+void OcrHandler::setStageStatsEnabled(bool enabled) {
+    stageStatsEnabled_ = enabled;
+}
+
+StageStats const& OcrHandler::stageStats() const {
+    return stageStats_;
+}
+
+void OcrHandler::setTextBandCropEnabled(bool enabled) {
+    textBandCropEnabled_ = enabled;
+}
+
+void OcrHandler::beginRequest(ShowProgress const& showProgress) {
+    stageStats_.clear();
+    showProgress_ = showProgress;
+
+    requestStartUs_ = metrics::isEnabled() ? tracing::nowUs() : 0;
+    if (requestStartUs_) requestForwardStats_ = modelForwardStats();
+}
+
+// images finished together share the duration and forwards since the previous call evenly
+void OcrHandler::endRequest(int numImages) {
+    if (metrics::isEnabled() && requestStartUs_ && numImages > 0) {
+        static metrics::Counter& images = metrics::counter("cz_ocr_images_total", "Images processed.");
+        static metrics::Histogram& durations = metrics::histogram("cz_ocr_image_duration_us", "Processing time per image in microseconds.");
+        static metrics::Histogram& forwards = metrics::histogram("cz_ocr_forwards_per_image", "Network forwards per image.");
+
+        uint64_t nowUs = tracing::nowUs();
+        ForwardStats forwardStats = modelForwardStats();
+        images.add(numImages);
+        for (int i = 0; i < numImages; ++i) {
+            durations.record((nowUs - requestStartUs_) / numImages);
+            forwards.record((forwardStats.numForwards - requestForwardStats_.numForwards) / numImages);
+        }
+
+        requestStartUs_ = nowUs;
+        requestForwardStats_ = forwardStats;
+    }
+
+    for (int i = 0; i < numImages; ++i) {
+        tracing::countRequest();
+    }
+}
+
+ForwardStats OcrHandler::modelForwardStats() const {
+    return ForwardStats();
+}
+
+bool OcrHandler::isTextBandCropEnabled() const {
+    return textBandCropEnabled_;
+}
+
+bool OcrHandler::isTimingStages() const {
+    return stageStatsEnabled_ || showProgress_ || metrics::isEnabled();
+}
+
+void OcrHandler::reportProgress(ProgressEvent const& event) {
+    if (stageStatsEnabled_) stageStats_.add(event);
+    if (metrics::isEnabled()) stageDurationHistogram(event.stage).record(static_cast<uint64_t>(event.wallMs * 1000));
+    if (showProgress_) showProgress_(*this, event);
+}
+
+cv::Size OcrHandler::standardSize() const {
+    return cv::Size();
+}
+
+void OcrHandler::updateImage(cv::Mat const& image) {
+    image_ = image;
+    normalizedImage_.invalidate();
+}
+
+void OcrHandler::standardizeImage(cv::Size const& size) {
+    if (image_.size() == size) return;
+
+    // never write into the buffer being read
+    if (standardizedFrame_.data == image_.data) standardizedFrame_ = cv::Mat();
+    standardizedFrame_.create(size, image_.type());
+    imgResizeAndFill(image_, standardizedFrame_);
+    updateImage(standardizedFrame_);
+}
+
+void OcrHandler::rotateImage(double angleInDegree) {
+    if (rotatedFrame_.data == image_.data) rotatedFrame_ = cv::Mat();
+    imgRotate(image_, rotatedFrame_, angleInDegree);
+    updateImage(rotatedFrame_);
+}
+
+NormalizedImage const& OcrHandler::normalizedImage() {
+    if (!normalizedImage_.isNormalizedFrom(image_)) {
+        normalizedImage_.assign(image_);
+    }
+    return normalizedImage_;
+}
+
 } // end namespace cz
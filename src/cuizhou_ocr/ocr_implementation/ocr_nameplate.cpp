@@ -24,7 +24,7 @@ OcrNameplate::OcrNameplate() = default;
 std::vector<KeyValueDetection> OcrNameplate::getResultAsArray() const {
     std::vector<KeyValueDetection> resultVector;
     std::transform(result_.cbegin(), result_.cend(), std::back_inserter(resultVector),
-                   [](std::pair<NameplateField const, KeyValueDetection> const& elem) { return elem.second; });
+                   [](FieldMap<KeyValueDetection>::value_type const& elem) { return elem.second; });
     return resultVector;
 }
 
@@ -5,8 +5,10 @@
 #include "ocr_implementation/ocr_nameplate_alfaromeo.h"
 #include <numeric>
 #include <opencv2/highgui/highgui.hpp>
+#include "data_utils/affine_transform.h"
 #include "data_utils/cv_extension.h"
 #include "data_utils/data_proc.hpp"
+#include "data_utils/text_band.h"
 #include "ocr_aux/detection_proc.h"
 
 
@@ -14,7 +16,7 @@ namespace cz {
 
 //std::vector<std::string> const OcrNameplateAlfaRomeoromeo::PAINT_CANDIDATES = {"414", "361", "217", "248", "092", "093", "035", "318", "408", "409", "620"};
 
-EnumHashMap<OcrNameplateAlfaRomeo::NameplateField, int> const OcrNameplateAlfaRomeo::VALUE_LENGTH = {
+OcrNameplateAlfaRomeo::FieldMap<int> const OcrNameplateAlfaRomeo::VALUE_LENGTH = {
         {NameplateField::VIN,                     17},
         {NameplateField::MAX_MASS_ALLOWED,        4},
         {NameplateField::MAX_NET_POWER_OF_ENGINE, 3},
@@ -26,6 +28,18 @@ EnumHashMap<OcrNameplateAlfaRomeo::NameplateField, int> const OcrNameplateAlfaRo
         {NameplateField::PAINT,                   3}
 };
 
+// each tile keeps the scale its ROI would have in its slot, so that the characters keep their trained size
+OcrNameplateAlfaRomeo::FieldMap<cv::Size> const OcrNameplateAlfaRomeo::COLLAGE_SLOT_SIZE = {
+        {NameplateField::ENGINE_MODEL,            cv::Size(396, 320)},
+        {NameplateField::VEHICLE_MODEL,           cv::Size(396, 320)},
+        {NameplateField::MAX_MASS_ALLOWED,        cv::Size(264, 320)},
+        {NameplateField::MAX_NET_POWER_OF_ENGINE, cv::Size(264, 320)},
+        {NameplateField::ENGINE_DISPLACEMENT,     cv::Size(264, 320)},
+        {NameplateField::DATE_OF_MANUFACTURE,     cv::Size(264, 320)},
+        {NameplateField::NUM_PASSENGERS,          cv::Size(132, 320)},
+        {NameplateField::PAINT,                   cv::Size(132, 320)}
+};
+
 /* ------- Auxiliary Functions Hidden in Anonymous Namespace ------- */
 namespace {
 
@@ -35,16 +49,22 @@ int const ROI_X_BORDER = 8;
 int const ROI_Y_BORDER = 4;
 int const CHAR_X_BORDER = 2;
 int const CHAR_Y_BORDER = 1;
+int const ROI_REFINE_TOLERANCE = 4;
+int const COLLAGE_MAX_WIDTH = 1056;
+int const MAX_IMAGES_PER_COLLAGE = 4;
+int const TEXT_BAND_Y_MARGIN = 32;
+double const TEXT_BAND_MIN_CONFIDENCE = 0.6;
 
-cv::Rect& extendRoiCoverage(cv::Rect& roi, std::vector<Detection> const& dets) {
+cv::Rect& extendRoiCoverage(cv::Rect& roi, DetectionSet const& dets) {
     assert(isSortedByXMid(dets));
 
-    int charSpacing = estimateCharSpacing(dets);
+    CharLineSummary summary = summarizeCharLine(dets);
+    int charSpacing = summary.spacing;
     roi.width = static_cast<int>(charSpacing * 17 * 1.1);
 
     int vacancy = 17 - static_cast<int>(dets.size());
     if (vacancy > 0) {
-        double slope = estimateCharAlignmentSlope(dets);
+        double slope = summary.slope;
         (slope > 0 ? roi.height : roi.y) += std::round(slope * charSpacing * vacancy);
     }
 
@@ -63,48 +83,92 @@ cv::Rect& adjustRoiToDetsExtent(cv::Rect& roi, cv::Rect detsExtentInRoi) {
     return roi;
 }
 
-void resolveOverlappedDetections(std::vector<Detection>& dets) {
+// fixes the scale of a detector for its lifetime, the scale is fitted to the input again afterwards
+class FixedScaleScope {
+public:
+    FixedScaleScope(Detector& detector, float scale) : detector_(detector) {
+        detector_.setFixedScale(scale);
+    }
+
+    ~FixedScaleScope() {
+        detector_.setFixedScale();
+    }
+
+    FixedScaleScope(FixedScaleScope const&) = delete;
+    FixedScaleScope& operator=(FixedScaleScope const&) = delete;
+
+private:
+    Detector& detector_;
+};
+
+void recordCollageFill(double fillRatio) {
+    static metrics::Histogram& fillPercents = metrics::histogram("cz_ocr_collage_fill_percent",
+                                                                 "Percentage of a collage image covered by tiles.");
+    if (metrics::isEnabled()) fillPercents.record(static_cast<uint64_t>(std::round(fillRatio * 100)));
+}
+
+bool isRoiChangedBeyondTolerance(cv::Rect const& roi, cv::Rect const& refinedRoi) {
+    return std::abs(roi.x - refinedRoi.x) > ROI_REFINE_TOLERANCE ||
+           std::abs(roi.y - refinedRoi.y) > ROI_REFINE_TOLERANCE ||
+           std::abs(roi.br().x - refinedRoi.br().x) > ROI_REFINE_TOLERANCE ||
+           std::abs(roi.br().y - refinedRoi.br().y) > ROI_REFINE_TOLERANCE;
+}
+
+void resolveOverlappedDetections(DetectionSet& dets) {
     if (dets.size() <= 17) return;
 
     std::vector<float> overlaps;
-    for (auto itr = std::next(dets.cbegin()); itr != dets.cend(); ++itr) {
-        float iou = computeIou(std::prev(itr)->rect, itr->rect);
+    for (size_t i = 1; i < dets.size(); ++i) {
+        float iou = computeIou(dets.rect(i - 1), dets.rect(i));
         overlaps.push_back(iou);
     }
 
     auto itrMaxOverlap = std::max_element(overlaps.cbegin(), overlaps.cend());
-    int idxMaxOverlap = static_cast<int>(std::distance(overlaps.cbegin(), itrMaxOverlap));
+    size_t idxMaxOverlap = static_cast<size_t>(std::distance(overlaps.cbegin(), itrMaxOverlap));
 
-    int idxToErase = dets[idxMaxOverlap].score < dets[idxMaxOverlap + 1].score ? idxMaxOverlap : idxMaxOverlap + 1;
-    dets.erase(std::next(dets.begin(), idxToErase));
+    size_t idxToErase = dets.score(idxMaxOverlap) < dets.score(idxMaxOverlap + 1) ? idxMaxOverlap : idxMaxOverlap + 1;
+    dets.erase(idxToErase);
 
     resolveOverlappedDetections(dets);
 }
 
-bool containsUnambiguousNumberOne(Detection const& lhs, Detection const& rhs) {
-    return (lhs.label == "1" && rhs.label != "7" && rhs.label != "4" && rhs.label != "H")
-           || (rhs.label == "1" && lhs.label != "7" && lhs.label != "4" && lhs.label != "H");
+bool containsUnambiguousNumberOne(int lhsClass, int rhsClass, CharClasses const& chars) {
+    return (lhsClass == chars.one && rhsClass != chars.seven && rhsClass != chars.four && rhsClass != chars.letterH)
+           || (rhsClass == chars.one && lhsClass != chars.seven && lhsClass != chars.four && lhsClass != chars.letterH);
 }
 
-void eliminateOverlapsByThresh(std::vector<Detection>& dets,
+void eliminateOverlapsByThresh(DetectionSet& dets,
                                std::pair<float, float> firstThresh,
                                std::pair<float, float> secondThresh,
-                               float lowConfThresh) {
+                               float lowConfThresh,
+                               CharClasses const& chars) {
     if (dets.size() < 2) return;
     assert(isSortedByXMid(dets));
 
-    auto isOverlapped = [&](Detection const& det1, Detection const& det2) {
-        float firstTol = containsUnambiguousNumberOne(det1, det2) ? firstThresh.first : firstThresh.second;
-        float secondTol = containsUnambiguousNumberOne(det1, det2) ? secondThresh.first : secondThresh.second;
-        float overlap = computeIou(det1.rect, det2.rect);
+    // the conflicts are resolved on indices, the set is compacted once at the end
+    auto isOverlapped = [&](size_t idx1, size_t idx2) {
+        bool hasOne = containsUnambiguousNumberOne(dets.classId(idx1), dets.classId(idx2), chars);
+        float firstTol = hasOne ? firstThresh.first : firstThresh.second;
+        float secondTol = hasOne ? secondThresh.first : secondThresh.second;
+        float overlap = computeIou(dets.rect(idx1), dets.rect(idx2));
         return overlap > firstTol ||
-               (overlap > secondTol && std::min(det1.score, det2.score) < lowConfThresh);
+               (overlap > secondTol && std::min(dets.score(idx1), dets.score(idx2)) < lowConfThresh);
     };
-    auto compareScore = [](Detection const& lhs, Detection const& rhs) {
-        return lhs.score < rhs.score;
+    auto compareScore = [&](size_t lhs, size_t rhs) {
+        return dets.score(lhs) < dets.score(rhs);
     };
 
-    resolveConflicts(dets, isOverlapped, compareScore);
+    // rects that overlap horizontally have x-mids closer than the wider of them
+    std::vector<size_t> indices(dets.size());
+    int maxWidth = 0;
+    for (size_t i = 0; i < dets.size(); ++i) {
+        indices[i] = i;
+        maxWidth = std::max(maxWidth, dets.rect(i).width);
+    }
+
+    resolveConflictsSorted(indices, isOverlapped, compareScore,
+                           [&](size_t idx) { return xMid(dets.rect(idx)); }, maxWidth);
+    dets.select(indices);
 }
 
 }
@@ -119,53 +183,194 @@ OcrNameplateAlfaRomeo::OcrNameplateAlfaRomeo(Detector detectorKeys,
         : detectorKeys_(std::move(detectorKeys)),
           detectorValuesVin_(std::move(detectorValuesVin)),
           detectorValuesStitched_(std::move(detectorValuesStitched)),
-          classifierChars_(std::move(classifierChars)) {}
+          classifierChars_(std::move(classifierChars)) {
+    if (detectorKeys_.labels()) keyFieldOfClass_ = fieldDict_.indexLabels(*detectorKeys_.labels());
+    if (detectorValuesVin_.labels()) vinChars_ = resolveCharClasses(*detectorValuesVin_.labels());
+    if (detectorValuesStitched_.labels()) stitchedChars_ = resolveCharClasses(*detectorValuesStitched_.labels());
+}
 
 void OcrNameplateAlfaRomeo::processImage(ShowProgress const& showProgress) {
+    {
+        CZ_TRACE_SCOPE("OcrNameplateAlfaRomeo::processImage");
+        beginRequest(showProgress);
+        processImageBeforeCollage();
+
+        std::vector<ImageState> states(1);
+        stashState(states.front());
+        detectValuesOfOtherCodeFields(states);
+        restoreState(states.front());
+        recordFieldMetrics();
+    }
+    endRequest();
+}
+
+std::vector<std::string> OcrNameplateAlfaRomeo::processImages(std::vector<cv::Mat> const& images,
+                                                              ShowProgress const& showProgress) {
+    beginRequest(showProgress);
+    std::vector<std::string> results;
+
+    // images are accumulated into groups that share the forwards of the stitched-value detector
+    // the group size is bounded to keep the latency of the first image in a group acceptable
+    for (int first = 0; first < images.size(); first += MAX_IMAGES_PER_COLLAGE) {
+        int last = std::min(first + MAX_IMAGES_PER_COLLAGE, static_cast<int>(images.size()));
+
+        {
+            CZ_TRACE_SCOPE("OcrNameplateAlfaRomeo::processImages");
+            std::vector<ImageState> states(last - first);
+            for (int i = first; i < last; ++i) {
+                setImageSource(images[i]);
+                processImageBeforeCollage();
+                stashState(states[i - first]);
+                // the frame buffers of the handler are overwritten by the next image of the batch
+                states[i - first].image = states[i - first].image.clone();
+            }
+
+            detectValuesOfOtherCodeFields(states);
+
+            for (auto& state : states) {
+                restoreState(state);
+                results.push_back(getResultAsString());
+                recordFieldMetrics();
+            }
+        }
+        endRequest(last - first);
+    }
+
+    return results;
+}
+
+cv::Size OcrNameplateAlfaRomeo::standardSize() const {
+    return cv::Size(STANDARD_IMG_WIDTH, STANDARD_IMG_HEIGHT);
+}
+
+// a field succeeds if its value has the expected number of characters
+void OcrNameplateAlfaRomeo::recordFieldMetrics() const {
+    if (!metrics::isEnabled()) return;
+
+    // the attempt and success counters of each field
+    static FieldMap<std::pair<metrics::Counter*, metrics::Counter*>> const counters = [] {
+        FieldMap<std::pair<metrics::Counter*, metrics::Counter*>> result;
+        for (auto const& lengthItem : VALUE_LENGTH) {
+            std::string labels = "field=\"" + fieldDict_.getName(lengthItem.first) + "\"";
+            result.emplace(lengthItem.first, std::make_pair(
+                    &metrics::counter("cz_ocr_field_attempts_total", "Images on which a field is expected.", labels),
+                    &metrics::counter("cz_ocr_field_success_total", "Images on which a field is read with its expected length.", labels)));
+        }
+        return result;
+    }();
+
+    for (auto const& lengthItem : VALUE_LENGTH) {
+        auto const& fieldCounters = counters.at(lengthItem.first);
+        fieldCounters.first->add();
+
+        auto itrResult = result_.find(lengthItem.first);
+        if (itrResult != result_.end() && itrResult->second.value.text.size() == lengthItem.second) {
+            fieldCounters.second->add();
+        }
+    }
+}
+
+ForwardStats OcrNameplateAlfaRomeo::modelForwardStats() const {
+    ForwardStats sum;
+    for (MlModel const* model : std::initializer_list<MlModel const*>{&detectorKeys_, &detectorValuesVin_,
+                                                                      &detectorValuesStitched_, &classifierChars_}) {
+        sum.numForwards += model->forwardStats().numForwards;
+        sum.numInputPixels += model->forwardStats().numInputPixels;
+    }
+    return sum;
+}
+
+void OcrNameplateAlfaRomeo::processImageBeforeCollage() {
     result_.clear();
 
-    image_ = imgResizeAndFill(image_, STANDARD_IMG_WIDTH, STANDARD_IMG_HEIGHT);
+    {
+        StageTimer timer(*this, ProcessStage::STANDARDIZE);
+        standardizeImage(standardSize());
+    }
 
     detectKeys();
     adaptiveRotationWithUpdatingKeyDetections();
 
     detectValueOfVin();
-    detectValuesOfOtherCodeFields();
+}
+
+void OcrNameplateAlfaRomeo::stashState(ImageState& state) {
+    state.image = image_;
+    state.keyOcrDetections.swap(keyOcrDetections_);
+    state.result.swap(result_);
+}
+
+void OcrNameplateAlfaRomeo::restoreState(ImageState& state) {
+    updateImage(state.image);
+    keyOcrDetections_.swap(state.keyOcrDetections);
+    result_.swap(state.result);
+}
+
+// the text band of the nameplate with a margin, or the whole image if it is not located confidently
+cv::Rect OcrNameplateAlfaRomeo::locateKeysRoi() {
+    cv::Rect imageExtent = extent(image_);
+    if (!isTextBandCropEnabled()) return imageExtent;
+
+    StageTimer timer(*this, ProcessStage::LOCATE_TEXT_BAND);
+    TextBand band = locateTextBand(image());
+    if (band.confidence < TEXT_BAND_MIN_CONFIDENCE) return imageExtent;
+
+    cv::Rect roi = band.rect;
+    expandRect(roi, 0, TEXT_BAND_Y_MARGIN);
+    return roi & imageExtent;
 }
 
 void OcrNameplateAlfaRomeo::detectKeys() {
+    cv::Rect keysRoi = locateKeysRoi();
+
+    StageTimer timer(*this, ProcessStage::DETECT_KEYS);
     keyOcrDetections_.clear();
 
     detectorKeys_.setThresh(0.5, 0.1); // fixed params, empirical
-
-    std::vector<Detection> keyDets = detectorKeys_.detect(image_);
-    std::transform(keyDets.cbegin(), keyDets.cend(),
-                   std::inserter(keyOcrDetections_, keyOcrDetections_.end()),
-                   [](Detection const& det) {
-                       std::string const& keyName = det.label;
-                       OcrDetection keyItem(keyName, det.rect);
-                       return std::make_pair(fieldDict_.toEnum(keyName), keyItem);
-                   });
+    DetectionSet keyDets;
+    if (keysRoi == extent(image_)) {
+        keyDets = detectorKeys_.detectSet(normalizedImage(), keysRoi);
+    } else {
+        // a cropped band is scaled as the whole image would be, so that the keys keep the size the model is trained with
+        FixedScaleScope fixedScale(detectorKeys_, detectorKeys_.fitScale(image_.size()));
+        keyDets = detectorKeys_.detectSet(normalizedImage(), keysRoi);
+    }
+    timer.setNumDetections(keyDets.size());
+    // the first detection of each field is kept
+    for (size_t i = 0; i < keyDets.size(); ++i) {
+        NameplateField field = keyFieldOfClass_[keyDets.classId(i)];
+        if (field == NameplateField::UNKNOWN) continue;
+        keyOcrDetections_.emplace(field, OcrDetection(keyDets.label(i), keyDets.rect(i) + keysRoi.tl()));
+    }
 }
 
 void OcrNameplateAlfaRomeo::adaptiveRotationWithUpdatingKeyDetections() {
     auto itrKeyVin = keyOcrDetections_.find(NameplateField::VIN);
     if (itrKeyVin == keyOcrDetections_.end()) return;
 
-    detectorValuesVin_.setThresh(0.1, 0.3);
+    double slope;
+    {
+        StageTimer timer(*this, ProcessStage::ROTATION_PROBE);
+        detectorValuesVin_.setThresh(0.1, 0.3);
 
-    cv::Rect const& keyRoi = itrKeyVin->second.rect;
-    cv::Rect valueRoi = estimateValueRoi(NameplateField::VIN, keyRoi);
-    std::vector<Detection> valueDets = detectorValuesVin_.detect(image_(valueRoi));
+        cv::Rect const& keyRoi = itrKeyVin->second.rect;
+        cv::Rect valueRoi = estimateValueRoi(NameplateField::VIN, keyRoi);
+        DetectionSet valueDets = detectorValuesVin_.detectSet(normalizedImage(), valueRoi);
+
+        valueDets.sortByXMid();
+        eliminateOverlaps(valueDets, NameplateField::VIN, vinChars_);
+        eliminateYOutliers(valueDets);
+        timer.setNumDetections(valueDets.size());
 
-    sortByXMid(valueDets);
-    eliminateOverlaps(valueDets, NameplateField::VIN);
-    eliminateYOutliers(valueDets);
+        slope = estimateCharAlignmentSlope(valueDets);
+    }
 
-    double slope = estimateCharAlignmentSlope(valueDets);
     if (std::abs(slope) > 0.025) {
         double angle = std::atan(slope) / CV_PI * 180;
-        image_ = imgRotate(image_, angle);
+        {
+            StageTimer timer(*this, ProcessStage::ROTATE);
+            rotateImage(angle);
+        }
         detectKeys(); // update detections of keys
     }
 }
@@ -180,49 +385,67 @@ void OcrNameplateAlfaRomeo::detectValueOfVin() {
     cv::Rect keyRoi = keyItem.rect;
     cv::Rect valueRoi = estimateValueRoi(NameplateField::VIN, keyRoi);
     valueRoi &= extent(image_);
-    // no need to resize and fill because the model for VIN is trained with stretched images
-    std::vector<Detection> valueDets = detectorValuesVin_.detect(image_(valueRoi));
+    DetectionSet valueDets;
 
-    sortByXMid(valueDets);
-    eliminateOverlaps(valueDets, NameplateField::VIN);
-    eliminateYOutliers(valueDets);
+    {
+        StageTimer timer(*this, ProcessStage::VIN_ROUND_1);
+        // no need to resize and fill because the model for VIN is trained with stretched images
+        valueDets = detectorValuesVin_.detectSet(normalizedImage(), valueRoi);
 
-    // second round in the network
-    adjustRoiToDetsExtent(valueRoi, computeExtent(valueDets));
-    extendRoiCoverage(valueRoi, valueDets);
-    valueRoi &= extent(image_);
-    valueDets = detectorValuesVin_.detect(image_(valueRoi));
+        valueDets.sortByXMid();
+        eliminateOverlaps(valueDets, NameplateField::VIN, vinChars_);
+        eliminateYOutliers(valueDets);
+        timer.setNumDetections(valueDets.size());
+    }
 
-    sortByXMid(valueDets);
-    eliminateOverlaps(valueDets, NameplateField::VIN);
-    eliminateYOutliers(valueDets);
+    {
+        // second round in the network
+        StageTimer timer(*this, ProcessStage::VIN_ROUND_2);
+        adjustRoiToDetsExtent(valueRoi, valueDets.extent());
+        extendRoiCoverage(valueRoi, valueDets);
+        valueRoi &= extent(image_);
+        valueDets = detectorValuesVin_.detectSet(normalizedImage(), valueRoi);
 
-    cv::Rect detsExtent = computeExtent(valueDets);
+        valueDets.sortByXMid();
+        eliminateOverlaps(valueDets, NameplateField::VIN, vinChars_);
+        eliminateYOutliers(valueDets);
+        timer.setNumDetections(valueDets.size());
+    }
+
+    cv::Rect detsExtent = valueDets.extent();
     if (isRoiTooLargeForDetsExtent(valueRoi, detsExtent)) {
         // third round in the network
+        StageTimer timer(*this, ProcessStage::VIN_ROUND_3);
         adjustRoiToDetsExtent(valueRoi, detsExtent);
         valueRoi &= extent(image_);
-        valueDets = detectorValuesVin_.detect(image_(valueRoi));
+        valueDets = detectorValuesVin_.detectSet(normalizedImage(), valueRoi);
 
-        sortByXMid(valueDets);
-        eliminateOverlaps(valueDets, NameplateField::VIN);
+        valueDets.sortByXMid();
+        eliminateOverlaps(valueDets, NameplateField::VIN, vinChars_);
         eliminateYOutliers(valueDets);
+        timer.setNumDetections(valueDets.size());
     }
 
     if (valueDets.size() < 17) {
         // fourth round in the network
+        StageTimer timer(*this, ProcessStage::GAPS);
+        size_t numDetsBefore = valueDets.size();
         addGapDetections(valueDets, valueRoi);
-        sortByXMid(valueDets);
+        valueDets.sortByXMid();
+        timer.setNumDetections(valueDets.size() - numDetsBefore);
     }
 
     if (valueDets.size() > 17) {
         resolveOverlappedDetections(valueDets);
     }
 
-    updateByClassification(valueDets, image_(valueRoi));
+    {
+        StageTimer timer(*this, ProcessStage::CLASSIFY);
+        updateByClassification(valueDets, image_(valueRoi), vinChars_);
+    }
 
     OcrDetection valueItem = joinDetections(valueDets);
-    valueItem.rect = PerspectiveTransform(1, valueRoi.x, valueRoi.y).apply(valueItem.rect);
+    valueItem.rect = AffineTransform::translation(valueRoi.x, valueRoi.y).apply(valueItem.rect);
 
     result_.emplace(NameplateField::VIN, KeyValueDetection(keyItem, valueItem));
 }
@@ -298,7 +521,7 @@ cv::Rect OcrNameplateAlfaRomeo::estimateValueRoi(NameplateField field, cv::Rect
     }
 }
 
-void OcrNameplateAlfaRomeo::eliminateOverlaps(std::vector<Detection>& dets, NameplateField field){
+void OcrNameplateAlfaRomeo::eliminateOverlaps(DetectionSet& dets, NameplateField field, CharClasses const& chars){
     std::pair<float, float> firstThresh, secondThresh;
     switch (field) {
         // for fields of which value characters are compact
@@ -316,20 +539,20 @@ void OcrNameplateAlfaRomeo::eliminateOverlaps(std::vector<Detection>& dets, Name
             secondThresh = std::make_pair(0.4, 0.2);
         } break;
     }
-    eliminateOverlapsByThresh(dets, firstThresh, secondThresh, 0.2);
+    eliminateOverlapsByThresh(dets, firstThresh, secondThresh, 0.2, chars);
 }
 
-void OcrNameplateAlfaRomeo::addGapDetections(std::vector<Detection>& dets, cv::Rect const& roi) {
+void OcrNameplateAlfaRomeo::addGapDetections(DetectionSet& dets, cv::Rect const& roi) {
     if (dets.size() <= 2 || dets.size() >= 17) return;
     assert(isSortedByXMid(dets));
 
     detectorValuesVin_.setThresh(0.05, 0.3);
-    std::vector<Detection> addedDets;
+    DetectionSet addedDets(dets.labels());
 
     int spacingRef = estimateCharSpacing(dets);
-    for (auto itr = std::next(dets.cbegin()); itr != dets.cend(); ++itr) {
-        cv::Rect const& leftRect = std::prev(itr)->rect;
-        cv::Rect const& rightRect = itr->rect;
+    for (size_t i = 1; i < dets.size(); ++i) {
+        cv::Rect leftRect = dets.rect(i - 1);
+        cv::Rect rightRect = dets.rect(i);
 
         if (computeSpacing(leftRect, rightRect) > 1.5 * spacingRef) {
             int gapX = leftRect.br().x;
@@ -344,122 +567,180 @@ void OcrNameplateAlfaRomeo::addGapDetections(std::vector<Detection>& dets, cv::R
 
             cv::Size sizeExpanded(gapRectReal.width * 10, gapRectReal.height);
             cv::Mat gapExpanded = imgResizeAndFill(image_(gapRectReal), sizeExpanded);
-            std::vector<Detection> gapDets = detectorValuesVin_.detect(gapExpanded);
+            DetectionSet gapDets = detectorValuesVin_.detectSet(gapExpanded);
 
             if (!gapDets.empty()) {
-                Detection& gapDet = gapDets.front();
-                gapDet.rect = gapRect & roi;
-
-                addedDets.push_back(std::move(gapDet));
+                addedDets.add(gapDets.classId(0), gapRect & roi, gapDets.score(0));
             }
         }
     }
 
-    dets.insert(dets.end(), addedDets.cbegin(), addedDets.cend());
+    dets.append(addedDets);
 }
 
-void OcrNameplateAlfaRomeo::updateByClassification(std::vector<Detection>& dets, cv::Mat const& srcImg) const {
-    for (auto& det : dets) {
-        if (!isNumbericChar(det.label)) continue;
-        if (det.score >= 0.8) continue;
-
-        if (det.rect.area() == 0) continue;
-        std::vector<Classification> clss = classifierChars_.classify(srcImg(det.rect), 1);
-        if (clss.front().score > 0.9) {
-            det.label = clss.front().label;
-            det.score = clss.front().score;
+void OcrNameplateAlfaRomeo::updateByClassification(DetectionSet& dets, cv::Mat const& srcImg,
+                                                   CharClasses const& chars) const {
+    for (size_t i = 0; i < dets.size(); ++i) {
+        if (!chars.isNumeric[dets.classId(i)]) continue;
+        if (dets.score(i) >= 0.8) continue;
+
+        cv::Rect rect = dets.rect(i);
+        if (rect.area() == 0) continue;
+        std::vector<Classification> clss = classifierChars_.classify(srcImg(rect), 1);
+        // a label the detector does not know cannot be stored by class id, the detection is kept as it is
+        int classId = dets.classIdOf(clss.front().label);
+        if (clss.front().score > 0.9 && classId >= 0) {
+            dets.setClass(i, classId, clss.front().score);
         }
     }
 };
 
-void OcrNameplateAlfaRomeo::detectValuesOfOtherCodeFields() {
+void OcrNameplateAlfaRomeo::detectValuesOfOtherCodeFields(std::vector<ImageState>& states) {
     detectorValuesStitched_.setThresh(0.05, 0.3);
+    // the tiles are already at the scale of the fixed layout, which the detector ran at without rescaling
+    detectorValuesStitched_.setFixedScale(1);
 
     std::vector<NameplateField> fields = {NameplateField::ENGINE_MODEL, NameplateField::VEHICLE_MODEL,
                                           NameplateField::MAX_MASS_ALLOWED, NameplateField::MAX_NET_POWER_OF_ENGINE,
                                           NameplateField::ENGINE_DISPLACEMENT, NameplateField::DATE_OF_MANUFACTURE,
                                           NameplateField::NUM_PASSENGERS, NameplateField::PAINT};
 
-    std::vector<cv::Rect> targetRois = {cv::Rect(0, 0, 396, 320), cv::Rect(0, 320, 396, 320),
-                                        cv::Rect(396, 0, 264, 320), cv::Rect(396, 320, 264, 320),
-                                        cv::Rect(660, 0, 264, 320), cv::Rect(660, 320, 264, 320),
-                                        cv::Rect(924, 0, 132, 320), cv::Rect(924, 320, 132, 320)};
-
-    // the mapping from ROIs on the source image to the collage image
-    // the first and second item of the pair<Rect, Rect> are origin ROI and target ROI respectively
-    EnumHashMap<NameplateField, std::pair<cv::Rect, cv::Rect>> roiMapping;
-    for (int i = 0; i < fields.size(); ++i) {
-        auto itrKeyItem = keyOcrDetections_.find(fields[i]);
-        if (itrKeyItem == keyOcrDetections_.end()) continue;
-
-        cv::Rect originRoi = estimateValueRoi(fields[i], itrKeyItem->second.rect);
-        originRoi &= extent(image_);
-        roiMapping.emplace(fields[i], std::make_pair(originRoi, targetRois[i]));
-    }
+    // ROIs on the source images to be packed into the collage image
+    std::vector<cv::Mat> images;
+    std::vector<FieldMap<cv::Rect>> originRois(states.size());
+    for (int i = 0; i < states.size(); ++i) {
+        ImageState const& state = states[i];
+        images.push_back(state.image);
 
-    cv::Size collageSize(1056, 640);
+        for (NameplateField field : fields) {
+            auto itrKeyItem = state.keyOcrDetections.find(field);
+            if (itrKeyItem == state.keyOcrDetections.end()) continue;
 
-    Collage<NameplateField> collage(image_, roiMapping, collageSize);
-    std::vector<Detection> collageDets = detectorValuesStitched_.detect(collage.image());
-    EnumHashMap<NameplateField, std::vector<Detection>> stitchedDets = collage.splitDetections(collageDets);
-    postprocessStitchedDetections(stitchedDets);
+            cv::Rect originRoi = estimateValueRoi(field, itrKeyItem->second.rect);
+            originRoi &= extent(state.image);
+            originRois[i].emplace(field, originRoi);
+        }
+    }
 
-    for (auto const& splitItem : stitchedDets) {
-        NameplateField field = splitItem.first;
-        std::vector<Detection> const& dets = splitItem.second;
-
-        cv::Rect& originRoi = roiMapping[field].first;
-        cv::Rect detsExtent = computeExtent(dets);
-        // coordinates in dectections are relative to the source image
-        // convert them to relative to the roi
-        detsExtent = PerspectiveTransform(1, -originRoi.x, -originRoi.y).apply(detsExtent);
-        adjustRoiToDetsExtent(originRoi, detsExtent);
-        originRoi &= extent(image_);
+    std::vector<FieldMap<DetectionSet>> stitchedDets;
+    {
+        StageTimer timer(*this, ProcessStage::COLLAGE_PASS_1);
+        Collage<NameplateField> collage(images, originRois, COLLAGE_SLOT_SIZE, COLLAGE_MAX_WIDTH, collageCanvas_);
+        if (collage.empty()) return;
+        recordCollageFill(collage.fillRatio());
+
+        DetectionSet collageDets = detectorValuesStitched_.detectSet(collage.image());
+        timer.setNumDetections(collageDets.size());
+        stitchedDets = collage.splitDetectionsByImage(collageDets);
+        for (auto& imageDets : stitchedDets) {
+            postprocessStitchedDetections(imageDets);
+        }
     }
 
-    collage = Collage<NameplateField>(image_, roiMapping, collageSize);
-    collageDets = detectorValuesStitched_.detect(collage.image());
-    stitchedDets = collage.splitDetections(collageDets);
-    postprocessStitchedDetections(stitchedDets);
+    // only the fields whose ROI shifts noticeably after being adjusted to the detections,
+    // or whose detections do not match the expected value length, go through the second round
+    // their tiles are packed into a smaller collage while the other fields keep the first-round detections
+    std::vector<FieldMap<cv::Rect>> refinedOriginRois(states.size());
+    bool needsSecondRound = false;
+    for (int i = 0; i < states.size(); ++i) {
+        for (auto const& roiItem : originRois[i]) {
+            NameplateField field = roiItem.first;
+            cv::Rect const& originRoi = roiItem.second;
+            cv::Rect refinedRoi = originRoi;
+            bool lengthMatched = false;
+
+            auto itrDets = stitchedDets[i].find(field);
+            if (itrDets != stitchedDets[i].end() && !itrDets->second.empty()) {
+                DetectionSet const& dets = itrDets->second;
+
+                cv::Rect detsExtent = dets.extent();
+                // coordinates in dectections are relative to the source image
+                // convert them to relative to the roi
+                detsExtent = PerspectiveTransform(1, -originRoi.x, -originRoi.y).apply(detsExtent);
+                adjustRoiToDetsExtent(refinedRoi, detsExtent);
+                refinedRoi &= extent(states[i].image);
+
+                auto itrValueLength = VALUE_LENGTH.find(field);
+                lengthMatched = (itrValueLength != VALUE_LENGTH.end() && dets.size() == itrValueLength->second);
+            }
 
-    for (auto& splitItem : stitchedDets) {
-        updateByClassification(splitItem.second, image_);
+            if (lengthMatched && !isRoiChangedBeyondTolerance(originRoi, refinedRoi)) continue;
+            refinedOriginRois[i].emplace(field, refinedRoi);
+            needsSecondRound = true;
+        }
     }
 
-    for (auto const& splitItem : stitchedDets) {
-        NameplateField field = splitItem.first;
-        std::vector<Detection> const& dets = splitItem.second;
+    if (needsSecondRound) {
+        StageTimer timer(*this, ProcessStage::COLLAGE_PASS_2);
+        // the first collage is no longer needed, its canvas is overwritten by the refined one
+        Collage<NameplateField> refinedCollage(images, refinedOriginRois, COLLAGE_SLOT_SIZE, COLLAGE_MAX_WIDTH, collageCanvas_);
+        recordCollageFill(refinedCollage.fillRatio());
+        DetectionSet refinedCollageDets = detectorValuesStitched_.detectSet(refinedCollage.image());
+        timer.setNumDetections(refinedCollageDets.size());
+        std::vector<FieldMap<DetectionSet>> refinedStitchedDets =
+                refinedCollage.splitDetectionsByImage(refinedCollageDets);
+
+        for (int i = 0; i < states.size(); ++i) {
+            postprocessStitchedDetections(refinedStitchedDets[i]);
+
+            for (auto const& roiItem : refinedOriginRois[i]) {
+                stitchedDets[i].erase(roiItem.first);
+            }
+            for (auto& splitItem : refinedStitchedDets[i]) {
+                stitchedDets[i][splitItem.first] = std::move(splitItem.second);
+            }
+        }
+    }
+
+    for (int i = 0; i < states.size(); ++i) {
+        ImageState& state = states[i];
 
-        auto itrKeyItem = keyOcrDetections_.find(field);
-        if (itrKeyItem == keyOcrDetections_.end()) continue;
+        {
+            StageTimer timer(*this, ProcessStage::CLASSIFY);
+            for (auto& splitItem : stitchedDets[i]) {
+                updateByClassification(splitItem.second, state.image, stitchedChars_);
+            }
+        }
+
+        for (auto const& splitItem : stitchedDets[i]) {
+            NameplateField field = splitItem.first;
+            DetectionSet const& dets = splitItem.second;
 
-        OcrDetection const& keyItem = itrKeyItem->second;
-        OcrDetection valueItem = joinDetections(dets);
+            auto itrKeyItem = state.keyOcrDetections.find(field);
+            if (itrKeyItem == state.keyOcrDetections.end()) continue;
 
-        result_.emplace(field, KeyValueDetection(keyItem, valueItem));
+            OcrDetection const& keyItem = itrKeyItem->second;
+            OcrDetection valueItem = joinDetections(dets);
+
+            state.result.emplace(field, KeyValueDetection(keyItem, valueItem));
+        }
     }
 }
 
-void OcrNameplateAlfaRomeo::postprocessStitchedDetections(EnumHashMap<NameplateField, std::vector<Detection>>& stitchedDets) {
+void OcrNameplateAlfaRomeo::postprocessStitchedDetections(FieldMap<DetectionSet>& stitchedDets) const {
     for (auto& splitItem : stitchedDets) {
         NameplateField field = splitItem.first;
-        std::vector<Detection>& dets = splitItem.second;
+        DetectionSet& dets = splitItem.second;
 
-        sortByXMid(dets);
-        eliminateOverlaps(dets, field);
+        dets.sortByXMid();
+        eliminateOverlaps(dets, field, stitchedChars_);
         eliminateYOutliers(dets);
 
         if (!shouldContainLetters(field)) {
-            eliminateLetters(dets);
+            eliminateLetters(dets, stitchedChars_);
         }
 
         auto itrValueLength = VALUE_LENGTH.find(field);
         int valueLength = (itrValueLength == VALUE_LENGTH.end() ? 20 : itrValueLength->second);
         if (dets.size() > valueLength) {
-            std::partial_sort(dets.begin(), std::next(dets.begin(), valueLength), dets.end(),
-                              [](Detection const& lhs, Detection const& rhs) { return lhs.score > rhs.score; });
-            dets.resize(valueLength);
-            sortByXMid(dets);
+            // the most confident ones are kept
+            std::vector<size_t> order(dets.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), std::next(order.begin(), valueLength), order.end(),
+                              [&](size_t lhs, size_t rhs) { return dets.score(lhs) > dets.score(rhs); });
+            order.resize(valueLength);
+            dets.select(order);
+            dets.sortByXMid();
         }
     }
 }
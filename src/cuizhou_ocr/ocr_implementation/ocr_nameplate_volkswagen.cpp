@@ -12,9 +12,11 @@ OcrNameplateVolkswagen::OcrNameplateVolkswagen(Detector detectorValues)
         : detectorValues_(std::move(detectorValues)) {}
 
 void OcrNameplateVolkswagen::processImage(ShowProgress const& showProgress) {
+    beginRequest(showProgress);
     detectorValues_.setThresh(0.1, 0.2);
     std::vector<Detection> dets = detectorValues_.detect(image_);
     Detector::drawBox(image_, dets);
+    endRequest();
 }
 
 } // end namespace cz
\ No newline at end of file
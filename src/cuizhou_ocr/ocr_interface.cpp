@@ -46,14 +46,31 @@ void OcrInterface::setImageSource(cv::Mat const& img) {
     ocrHandler_->setImageSource(img);
 }
 
+void OcrInterface::importEncoded(uint8_t const* data, size_t size) {
+    ocrHandler_->importEncoded(data, size);
+}
+
+void OcrInterface::importFrame(RawFrame const& frame) {
+    ocrHandler_->importFrame(frame);
+}
+
 void OcrInterface::processImage(OcrHandler::ShowProgress const& showProgress) {
     ocrHandler_->processImage(showProgress);
 }
 
+std::vector<std::string> OcrInterface::processImages(std::vector<cv::Mat> const& images,
+                                                     OcrHandler::ShowProgress const& showProgress) {
+    return ocrHandler_->processImages(images, showProgress);
+}
+
 cv::Mat const& OcrInterface::image() const {
     return ocrHandler_->image();
 }
 
+cv::Size OcrInterface::standardSize() const {
+    return ocrHandler_->standardSize();
+}
+
 std::string OcrInterface::getResultAsString() const {
     return ocrHandler_->getResultAsString();
 }
@@ -62,4 +79,16 @@ cv::Mat OcrInterface::drawResult() const {
     return ocrHandler_->drawResult();
 }
 
+void OcrInterface::setStageStatsEnabled(bool enabled) {
+    ocrHandler_->setStageStatsEnabled(enabled);
+}
+
+StageStats const& OcrInterface::stageStats() const {
+    return ocrHandler_->stageStats();
+}
+
+void OcrInterface::setTextBandCropEnabled(bool enabled) {
+    ocrHandler_->setTextBandCropEnabled(enabled);
+}
+
 } // end namespace cz
\ No newline at end of file
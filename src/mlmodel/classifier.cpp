@@ -1,6 +1,8 @@
 // Edited by Zhihao Liu, Apr. 2018
 
 #include "classifier.h"
+#include "tracing.h"
+#include "metrics.h"
 
 
 namespace cz {
@@ -56,8 +58,28 @@ std::vector<int> Classifier::argmax(std::vector<float> const& v, int n) {
     return result;
 }
 
+void Classifier::initMock(std::vector<std::string> const& labels, MockOptions const& options) {
+    labels_ = labels;
+    net_.reset();
+    mock_ = std::make_shared<MockBackend>(labels, options);
+}
+
+void Classifier::recordTo(std::string const& fixturePath) {
+    mock_ = MockBackend::recorder(fixturePath);
+}
+
 /* Return the top n predictions. */
 std::vector<Classification> Classifier::classify(cv::Mat const& img, int n) const {
+    CZ_TRACE_SCOPE_CAT("Classifier::classify", "mlmodel");
+
+    uint64_t mockKey = mock_ ? MockBackend::hashPixels(img, static_cast<uint64_t>(n)) : 0;
+    if (mock_ && !mock_->isRecording()) {
+        mock_->simulateLatency();
+        // there is no network to take the input geometry from, the image is counted at its own size
+        countForward(static_cast<long>(img.rows) * img.cols);
+        return mock_->classify(mockKey, n);
+    }
+
     std::vector<float> output = predict(img);
 
     n = std::min(int(labels_.size()), n);
@@ -68,6 +90,8 @@ std::vector<Classification> Classifier::classify(cv::Mat const& img, int n) cons
         classifications.emplace_back(labels_[idx], output[idx]);
     }
 
+    if (mock_) mock_->recordClassifications(mockKey, classifications);
+
     return classifications;
 }
 
@@ -119,6 +143,11 @@ std::vector<float> Classifier::predict(cv::Mat const& img) const {
     preprocess(img, input_channels);
 
     net_->Forward();
+    countForward(input_geometry_.area());
+    if (metrics::isEnabled()) {
+        static metrics::Counter& forwards = metrics::counter("cz_model_forwards_total", "Network forwards run by the models.", "model=\"classifier\"");
+        forwards.add();
+    }
 
     /* Copy the output layer to a std::vector */
     Blob<float>* output_layer = net_->output_blobs()[0];
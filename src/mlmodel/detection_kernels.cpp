@@ -0,0 +1,133 @@
+#include "detection_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace cz {
+namespace kernels {
+
+namespace {
+
+struct Info {
+    float score;
+    const float* head;
+};
+
+} // end anonymous namespace
+
+float iou(const float A[], const float B[]) {
+    using namespace std;
+
+    if (A[0] > B[2] || A[1] > B[3] || A[2] < B[0] || A[3] < B[1]) return 0;
+
+    const float x1 = max(A[0], B[0]);
+    const float y1 = max(A[1], B[1]);
+    const float x2 = min(A[2], B[2]);
+    const float y2 = min(A[3], B[3]);
+
+    const float width = max(0.0f, x2 - x1 + 1.0f);
+    const float height = max(0.0f, y2 - y1 + 1.0f);
+    const float area = width * height;
+
+    const float A_area = (A[2] - A[0] + 1.0f) * (A[3] - A[1] + 1.0f);
+    const float B_area = (B[2] - B[0] + 1.0f) * (B[3] - B[1] + 1.0f);
+
+    return area / (A_area + B_area - area);
+}
+
+void nms(int* keep_out, int* num_out, const float* boxes_host, int boxes_num, int boxes_dim, float nms_overlap_thresh) {
+    using namespace std;
+
+    int count = 0;
+    vector<char> is_dead(boxes_num, 0);
+
+    for (int i = 0; i < boxes_num; ++i) {
+        if (is_dead[i]) continue;
+        keep_out[count++] = i;
+        for (int j = i + 1; j < boxes_num; ++j) {
+            if (!is_dead[j] && iou(&boxes_host[i * 5], &boxes_host[j * 5])>nms_overlap_thresh) {
+                is_dead[j] = 1;
+            }
+        }
+    }
+    *num_out = count;
+    is_dead.clear();
+}
+
+/*
+* ===  FUNCTION  ======================================================================
+*         Name:  boxes_sort
+*  Description:  Sort the bounding box according score
+* =====================================================================================
+*/
+void boxes_sort(const int num, const float* pred, float* sorted_pred) {
+    using namespace std;
+
+    vector<Info> my;
+    Info tmp;
+    for (int i = 0; i < num; i++) {
+        tmp.score = pred[i * 5 + 4];
+        tmp.head = pred + i * 5;
+        my.push_back(tmp);
+    }
+
+    std::sort(my.begin(), my.end(),
+              [](Info const& info1, Info const& info2) { return info1.score > info2.score; });
+
+    for (int i = 0; i < num; i++) {
+        for (int j = 0; j < 5; j++) {
+            sorted_pred[i * 5 + j] = my[i].head[j];
+        }
+    }
+}
+
+/*
+* ===  FUNCTION  ======================================================================
+*         Name:  bbox_transform_inv
+*  Description:  Compute bounding box regression value
+* =====================================================================================
+*/
+void bbox_transform_inv(int num, int class_num, const float* box_deltas, const float* pred_cls, const float* boxes, float* pred, int img_height, int img_width) {
+    using namespace std;
+
+    float width, height, ctr_x, ctr_y, dx, dy, dw, dh, pred_ctr_x, pred_ctr_y, pred_w, pred_h;
+    for (int i = 0; i < num; i++) {
+        width = float(boxes[i * 4 + 2] - boxes[i * 4 + 0] + 1.0);
+        height = float(boxes[i * 4 + 3] - boxes[i * 4 + 1] + 1.0);
+        ctr_x = float(boxes[i * 4 + 0] + 0.5 * width);
+        ctr_y = float(boxes[i * 4 + 1] + 0.5 * height);
+        for (int j = 0; j < class_num; j++) {
+            dx = box_deltas[(i*class_num + j) * 4 + 0];
+            dy = box_deltas[(i*class_num + j) * 4 + 1];
+            dw = box_deltas[(i*class_num + j) * 4 + 2];
+            dh = box_deltas[(i*class_num + j) * 4 + 3];
+            pred_ctr_x = ctr_x + width*dx;
+            pred_ctr_y = ctr_y + height*dy;
+            pred_w = width * exp(dw);
+            pred_h = height * exp(dh);
+            pred[(j*num + i) * 5 + 0] = float(max(min(pred_ctr_x - 0.5* pred_w, (img_width - 1)*1.0), 0.0));
+            pred[(j*num + i) * 5 + 1] = float(max(min(pred_ctr_y - 0.5* pred_h, (img_height - 1)*1.0), 0.0));
+            pred[(j*num + i) * 5 + 2] = float(max(min(pred_ctr_x + 0.5* pred_w, (img_width - 1)*1.0), 0.0));
+            pred[(j*num + i) * 5 + 3] = float(max(min(pred_ctr_y + 0.5* pred_h, (img_height - 1)*1.0), 0.0));
+            pred[(j*num + i) * 5 + 4] = pred_cls[i*class_num + j];
+        }
+    }
+}
+
+void overThresh(const int* keep, int num_out, const float* sorted_pred_cls, float conf_thresh, int class_id, DetectionSet& dets) {
+    using namespace std;
+    using namespace cv;
+
+    int i = 0;
+    while (i < num_out) {
+        if (sorted_pred_cls[keep[i] * 5 + 4] < conf_thresh)
+            break;
+        Rect rect(Point(int(round(sorted_pred_cls[keep[i] * 5 + 0])), int(round(sorted_pred_cls[keep[i] * 5 + 1]))),
+                  Point(int(round(sorted_pred_cls[keep[i] * 5 + 2])), int(round(sorted_pred_cls[keep[i] * 5 + 3]))));
+        dets.add(class_id, rect, sorted_pred_cls[keep[i] * 5 + 4]);
+        ++i;
+    }
+}
+
+} // end namespace kernels
+} // end namespace cz
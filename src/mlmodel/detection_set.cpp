@@ -0,0 +1,211 @@
+#include "detection_set.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+
+namespace cz {
+
+namespace {
+
+// values[i] = old values[order[i]], values not in order are dropped
+template<typename T>
+void permute(std::vector<T>& values, std::vector<size_t> const& order) {
+    std::vector<T> permuted(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        permuted[i] = values[order[i]];
+    }
+    values.swap(permuted);
+}
+
+} // end anonymous namespace
+
+DetectionSet::~DetectionSet() = default;
+
+DetectionSet::DetectionSet() = default;
+
+DetectionSet::DetectionSet(std::shared_ptr<LabelTable const> labels) : labels_(std::move(labels)) {}
+
+DetectionSet DetectionSet::fromDetections(std::vector<Detection> const& dets, std::shared_ptr<LabelTable const> labels) {
+    DetectionSet set(std::move(labels));
+    set.reserve(dets.size());
+    for (auto const& det : dets) {
+        int classId = set.classIdOf(det.label);
+        if (classId < 0) throw std::invalid_argument("Label is not in the table: " + det.label);
+        set.add(classId, det.rect, det.score);
+    }
+    return set;
+}
+
+std::vector<Detection> DetectionSet::toDetections() const {
+    std::vector<Detection> dets;
+    dets.reserve(size());
+    for (size_t i = 0; i < size(); ++i) {
+        dets.emplace_back(label(i), rect(i), scores_[i]);
+    }
+    return dets;
+}
+
+size_t DetectionSet::size() const {
+    return scores_.size();
+}
+
+bool DetectionSet::empty() const {
+    return scores_.empty();
+}
+
+void DetectionSet::reserve(size_t capacity) {
+    for (auto* coords : {&x1_, &y1_, &x2_, &y2_}) {
+        coords->reserve(capacity);
+    }
+    scores_.reserve(capacity);
+    classIds_.reserve(capacity);
+}
+
+void DetectionSet::clear() {
+    for (auto* coords : {&x1_, &y1_, &x2_, &y2_}) {
+        coords->clear();
+    }
+    scores_.clear();
+    classIds_.clear();
+}
+
+void DetectionSet::add(int classId, cv::Rect const& rect, float score) {
+    assert(labels_ && classId >= 0 && classId < labels_->size());
+
+    x1_.push_back(rect.x);
+    y1_.push_back(rect.y);
+    x2_.push_back(rect.x + rect.width);
+    y2_.push_back(rect.y + rect.height);
+    scores_.push_back(score);
+    classIds_.push_back(static_cast<uint16_t>(classId));
+}
+
+void DetectionSet::append(DetectionSet const& other) {
+    assert(labels_ == other.labels_);
+
+    for (auto coords : {std::make_pair(&x1_, &other.x1_), std::make_pair(&y1_, &other.y1_),
+                        std::make_pair(&x2_, &other.x2_), std::make_pair(&y2_, &other.y2_)}) {
+        coords.first->insert(coords.first->end(), coords.second->cbegin(), coords.second->cend());
+    }
+    scores_.insert(scores_.end(), other.scores_.cbegin(), other.scores_.cend());
+    classIds_.insert(classIds_.end(), other.classIds_.cbegin(), other.classIds_.cend());
+}
+
+void DetectionSet::erase(size_t idx) {
+    for (auto* coords : {&x1_, &y1_, &x2_, &y2_}) {
+        coords->erase(std::next(coords->begin(), idx));
+    }
+    scores_.erase(std::next(scores_.begin(), idx));
+    classIds_.erase(std::next(classIds_.begin(), idx));
+}
+
+void DetectionSet::select(std::vector<size_t> const& indices) {
+    for (auto* coords : {&x1_, &y1_, &x2_, &y2_}) {
+        permute(*coords, indices);
+    }
+    permute(scores_, indices);
+    permute(classIds_, indices);
+}
+
+cv::Rect DetectionSet::rect(size_t idx) const {
+    return cv::Rect(x1_[idx], y1_[idx], x2_[idx] - x1_[idx], y2_[idx] - y1_[idx]);
+}
+
+float DetectionSet::score(size_t idx) const {
+    return scores_[idx];
+}
+
+int DetectionSet::classId(size_t idx) const {
+    return classIds_[idx];
+}
+
+std::string const& DetectionSet::label(size_t idx) const {
+    return (*labels_)[classIds_[idx]];
+}
+
+void DetectionSet::setRect(size_t idx, cv::Rect const& rect) {
+    x1_[idx] = rect.x;
+    y1_[idx] = rect.y;
+    x2_[idx] = rect.x + rect.width;
+    y2_[idx] = rect.y + rect.height;
+}
+
+void DetectionSet::setClass(size_t idx, int classId, float score) {
+    assert(classId >= 0 && classId < labels_->size());
+    classIds_[idx] = static_cast<uint16_t>(classId);
+    scores_[idx] = score;
+}
+
+std::shared_ptr<LabelTable const> const& DetectionSet::labels() const {
+    return labels_;
+}
+
+int DetectionSet::classIdOf(std::string const& label) const {
+    if (!labels_) return -1;
+    auto itr = std::find(labels_->cbegin(), labels_->cend(), label);
+    return itr == labels_->cend() ? -1 : static_cast<int>(std::distance(labels_->cbegin(), itr));
+}
+
+DetectionSet DetectionSet::selectClass(int classId) const {
+    DetectionSet selected(labels_);
+    for (size_t i = 0; i < size(); ++i) {
+        if (classIds_[i] == classId) selected.add(classId, rect(i), scores_[i]);
+    }
+    return selected;
+}
+
+// same values as computeIou() on cv::Rect, written without branches so that the loop vectorizes
+void DetectionSet::computeIous(size_t idx, float* ious) const {
+    int const ax1 = x1_[idx], ay1 = y1_[idx], ax2 = x2_[idx], ay2 = y2_[idx];
+    int const areaA = (ax2 - ax1) * (ay2 - ay1);
+    int const* x1 = x1_.data();
+    int const* y1 = y1_.data();
+    int const* x2 = x2_.data();
+    int const* y2 = y2_.data();
+
+    for (size_t i = 0; i < size(); ++i) {
+        int interWidth = std::max(0, std::min(ax2, x2[i]) - std::max(ax1, x1[i]));
+        int interHeight = std::max(0, std::min(ay2, y2[i]) - std::max(ay1, y1[i]));
+        int areaInter = interWidth * interHeight;
+        int areaB = (x2[i] - x1[i]) * (y2[i] - y1[i]);
+        ious[i] = static_cast<float>(areaInter) / (areaA + areaB - areaInter);
+    }
+}
+
+void DetectionSet::sortByXMid() {
+    // same x-mid as xMid() on cv::Rect
+    std::vector<int> xMids(size());
+    for (size_t i = 0; i < size(); ++i) {
+        xMids[i] = x1_[i] + (x2_[i] - x1_[i] - 1) / 2;
+    }
+
+    std::vector<size_t> order(size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return xMids[lhs] < xMids[rhs]; });
+
+    select(order);
+}
+
+cv::Rect DetectionSet::extent() const {
+    if (empty()) return cv::Rect();
+
+    // empty rects are folded in as the identity of min and max, so that the loop stays free of branches
+    int minX = std::numeric_limits<int>::max(), minY = std::numeric_limits<int>::max();
+    int maxX = std::numeric_limits<int>::min(), maxY = std::numeric_limits<int>::min();
+    for (size_t i = 0; i < size(); ++i) {
+        bool isEmpty = x2_[i] <= x1_[i] || y2_[i] <= y1_[i];
+        minX = std::min(minX, isEmpty ? std::numeric_limits<int>::max() : x1_[i]);
+        minY = std::min(minY, isEmpty ? std::numeric_limits<int>::max() : y1_[i]);
+        maxX = std::max(maxX, isEmpty ? std::numeric_limits<int>::min() : x2_[i]);
+        maxY = std::max(maxY, isEmpty ? std::numeric_limits<int>::min() : y2_[i]);
+    }
+    // the first rect is the union of empty rects only, as with cv::Rect
+    if (minX > maxX) return rect(0);
+    return cv::Rect(minX, minY, maxX - minX, maxY - minY);
+}
+
+} // end namespace cz
@@ -1,6 +1,10 @@
 // Edited by Zhihao Liu, Apr. 2018
 
 #include "detector.h"
+#include "detection_kernels.h"
+#include "tracing.h"
+#include "metrics.h"
+#include <cstring>
 #include <iostream>
 #include <string>
 #include "opencv2/highgui/highgui.hpp"
@@ -10,11 +14,25 @@
 namespace cz {
 
 void Detector::init(std::string const& def, std::string const& net, std::vector<std::string> const& classes) {
-    m_classes = classes;
+    m_classes = std::make_shared<LabelTable const>(classes);
     m_net = std::make_shared<caffe::Net<float>>(def, caffe::TEST);
     m_net->CopyTrainedLayersFrom(net);
 }
 
+void Detector::initMock(std::vector<std::string> const& classes, MockOptions const& options) {
+    m_classes = std::make_shared<LabelTable const>(classes);
+    m_net.reset();
+    m_mock = std::make_shared<MockBackend>(classes, options);
+}
+
+void Detector::recordTo(std::string const& fixturePath) {
+    m_mock = MockBackend::recorder(fixturePath);
+}
+
+std::shared_ptr<LabelTable const> const& Detector::labels() const {
+    return m_classes;
+}
+
 void Detector::setComputeMode(std::string const& mode, int id) {
     using namespace caffe;
 
@@ -31,29 +49,62 @@ void Detector::setThresh(float conf_thresh, float nms_thresh) {
     m_nmsThresh = nms_thresh;
 }
 
+void Detector::setFixedScale(float scale) {
+    m_fixedScale = scale;
+}
+
+float Detector::fitScale(cv::Size const& size) const {
+    if (m_fixedScale > 0) return m_fixedScale;
+
+    int im_size_min = std::min(size.height, size.width);
+    int im_size_max = std::max(size.height, size.width);
+    float im_scale = float(SCALES) / im_size_min;
+    if (std::round(im_scale * im_size_max) > MAX_SIZE) im_scale = float(MAX_SIZE) / im_size_max;
+    return im_scale;
+}
+
 std::vector<Detection> Detector::detect(cv::Mat const& img) const {
+    return detectSet(img).toDetections();
+}
+
+DetectionSet Detector::detectSet(cv::Mat const& img) const {
+    if (img.empty()) return DetectionSet(m_classes);
+
+    NormalizedImage normalized(img);
+    return detectSet(normalized, cv::Rect(0, 0, img.cols, img.rows));
+}
+
+std::vector<Detection> Detector::detect(NormalizedImage const& img, cv::Rect const& roi) const {
+    return detectSet(img, roi).toDetections();
+}
+
+DetectionSet Detector::detectSet(NormalizedImage const& img, cv::Rect const& roi) const {
+    CZ_TRACE_SCOPE_CAT("Detector::detect", "mlmodel");
     using namespace std;
     using namespace cv;
 
-    vector<Detection> dets;
+    DetectionSet dets(m_classes);
     int rpn_num;
     float *pred = nullptr;
 
-    if (img.empty()) return dets;
+    if (img.empty() || roi.area() == 0) return dets;
 
-    int im_size_min = min(img.rows, img.cols);
-    int im_size_max = max(img.rows, img.cols);
-    float im_scale = float(SCALES) / im_size_min;
-
-    if (round(im_scale * im_size_max) > MAX_SIZE) im_scale = float(MAX_SIZE) / im_size_max;
-    float im_scale_x = floor(img.cols * im_scale / SCALE_MULTIPLE_OF) * SCALE_MULTIPLE_OF / img.cols;
+    float im_scale = fitScale(roi.size());
+    float im_scale_x = floor(roi.width * im_scale / SCALE_MULTIPLE_OF) * SCALE_MULTIPLE_OF / roi.width;
 
-    float im_scale_y = floor(img.rows * im_scale / SCALE_MULTIPLE_OF) * SCALE_MULTIPLE_OF / img.rows;
-    int height = int(img.rows * im_scale_y);
-    int width = int(img.cols * im_scale_x);
+    float im_scale_y = floor(roi.height * im_scale / SCALE_MULTIPLE_OF) * SCALE_MULTIPLE_OF / roi.height;
+    int height = int(roi.height * im_scale_y);
+    int width = int(roi.width * im_scale_x);
     if (height <= 0 || width <= 0) return dets;
 
-    cv::Mat cv_resized;
+    // the thresholds change the output, so they are part of the input as far as fixtures are concerned
+    uint64_t mockKey = m_mock ? hashInput(img, roi) : 0;
+    if (m_mock && !m_mock->isRecording()) {
+        m_mock->simulateLatency();
+        countForward(static_cast<long>(height) * width);
+        return DetectionSet::fromDetections(m_mock->detect(mockKey, roi.size(), m_confThresh), m_classes);
+    }
+
     float im_info[6];
     float *boxes = nullptr;
 
@@ -61,48 +112,34 @@ std::vector<Detection> Detector::detect(cv::Mat const& img) const {
     const float* rois;
     const float* pred_cls;
 
-    cv::Mat cv_new(img.rows, img.cols, CV_32FC3, Scalar(0, 0, 0));
-    for (int h = 0; h < img.rows; ++h) {
-        for (int w = 0; w < img.cols; ++w) {
-            cv_new.at<cv::Vec3f>(cv::Point(w, h))[0] = float(img.at<cv::Vec3b>(cv::Point(w, h))[0]) - float(102.9801);
-            cv_new.at<cv::Vec3f>(cv::Point(w, h))[1] = float(img.at<cv::Vec3b>(cv::Point(w, h))[1]) - float(115.9465);
-            cv_new.at<cv::Vec3f>(cv::Point(w, h))[2] = float(img.at<cv::Vec3b>(cv::Point(w, h))[2]) - float(122.7717);
-        }
-    }
-
-    cv::resize(cv_new, cv_resized, cv::Size(width, height));
-
-    im_info[0] = cv_resized.rows;
-    im_info[1] = cv_resized.cols;
+    im_info[0] = height;
+    im_info[1] = width;
     im_info[2] = im_scale_x;
     im_info[3] = im_scale_y;
     im_info[4] = im_scale_x;
     im_info[5] = im_scale_y;
 
-    float *data_buf = new float[height*width * 3];
-    for (int h = 0; h < height; ++h) {
-        for (int w = 0; w < width; ++w) {
-            data_buf[(0 * height + h)*width + w] = float(cv_resized.at<cv::Vec3f>(cv::Point(w, h))[0]);
-            data_buf[(1 * height + h)*width + w] = float(cv_resized.at<cv::Vec3f>(cv::Point(w, h))[1]);
-            data_buf[(2 * height + h)*width + w] = float(cv_resized.at<cv::Vec3f>(cv::Point(w, h))[2]);
-        }
-    }
-
-    int channel_nums = cv_resized.channels();
+    int channel_nums = 3;
     m_net->blob_by_name("data")->Reshape(1, channel_nums, height, width);
     m_net->Reshape();
 
+    // the planes are already mean-subtracted, resizing them writes directly into the input layer
     float* input_data = m_net->blob_by_name("data")->mutable_cpu_data();
-    vector<cv::Mat> input_channels;
     for (int i = 0; i < channel_nums; ++i) {
         cv::Mat channel(height, width, CV_32FC1, input_data);
-        input_channels.push_back(channel);
+        cv::resize(img.plane(i)(roi), channel, cv::Size(width, height));
         input_data += height*width;
     }
-    cv::split(cv_resized, input_channels);
     m_net->blob_by_name("im_info")->set_cpu_data(im_info);
 
     m_net->ForwardFrom(0);
+    countForward(static_cast<long>(height) * width);
+    if (metrics::isEnabled()) {
+        static metrics::Counter& forwards = metrics::counter("cz_model_forwards_total", "Network forwards run by the models.", "model=\"detector\"");
+        static metrics::Histogram& inputPixels = metrics::histogram("cz_detector_input_pixels", "Input pixels of each detector forward.");
+        forwards.add();
+        inputPixels.record(static_cast<uint64_t>(height) * width);
+    }
 
     bbox_delt = m_net->blob_by_name("bbox_pred")->cpu_data();
 
@@ -116,8 +153,8 @@ std::vector<Detection> Detector::detect(cv::Mat const& img) const {
             boxes[n * 4 + c] = rois[n * 5 + c + 1] / im_info[c + 2];
         }
     }
-    pred = new float[rpn_num * 5 * m_classes.size()];
-    bbox_transform_inv(rpn_num, bbox_delt, pred_cls, boxes, pred, img.rows, img.cols);
+    pred = new float[rpn_num * 5 * m_classes->size()];
+    kernels::bbox_transform_inv(rpn_num, int(m_classes->size()), bbox_delt, pred_cls, boxes, pred, roi.height, roi.width);
 
     float *pred_per_class = nullptr;
     float *sorted_pred_cls = nullptr;
@@ -127,36 +164,45 @@ std::vector<Detection> Detector::detect(cv::Mat const& img) const {
     pred_per_class = new float[rpn_num * 5];
     sorted_pred_cls = new float[rpn_num * 5];
     keep = new int[rpn_num];
-    for (int i = 1; i < m_classes.size(); ++i)	{
+    for (int i = 1; i < m_classes->size(); ++i)	{
         for (int j = 0; j < rpn_num; ++j) {
             for (int k = 0; k<5; k++) {
                 pred_per_class[j * 5 + k] = pred[(i * rpn_num + j) * 5 + k];
             }
         }
-        boxes_sort(rpn_num, pred_per_class, sorted_pred_cls);
-        nms(keep, &num_out, sorted_pred_cls, rpn_num, 5, m_nmsThresh);
-        vector<Detection> singleDets = overThresh(keep, num_out, sorted_pred_cls, m_confThresh, m_classes[i]);
-        dets.insert(dets.end(), singleDets.begin(), singleDets.end());
+        kernels::boxes_sort(rpn_num, pred_per_class, sorted_pred_cls);
+        kernels::nms(keep, &num_out, sorted_pred_cls, rpn_num, 5, m_nmsThresh);
+        kernels::overThresh(keep, num_out, sorted_pred_cls, m_confThresh, i, dets);
     }
 
-    delete[] data_buf; data_buf = nullptr;
     delete[] boxes; boxes = nullptr;
     delete keep; keep = nullptr;
     delete pred_per_class; pred_per_class = nullptr;
     delete sorted_pred_cls; sorted_pred_cls = nullptr;
     delete pred; pred = nullptr;
 
+    if (m_mock) m_mock->recordDetections(mockKey, dets.toDetections());
+
     return dets;
 }
 
-std::vector<Detection> Detector::detect(cv::Mat const& img, std::string const& class_mask) const {
-    std::vector<Detection> dets = detect(img);
-    std::vector<Detection> mask_dets;
-
-    std::copy_if(dets.cbegin(), dets.cend(), std::back_inserter(mask_dets),
-                 [&](Detection const& det) { return det.label == class_mask; });
+uint64_t Detector::hashInput(NormalizedImage const& img, cv::Rect const& roi) const {
+    uint64_t hash = 0;
+    for (int i = 0; i < 3; ++i) {
+        hash = MockBackend::hashPixels(img.plane(i)(roi), hash);
+    }
+    for (float param : {m_confThresh, m_nmsThresh, m_fixedScale}) {
+        uint32_t bits;
+        std::memcpy(&bits, &param, sizeof(bits));
+        hash = MockBackend::hashCombine(hash, bits);
+    }
+    return hash;
+}
 
-    return mask_dets;
+std::vector<Detection> Detector::detect(cv::Mat const& img, std::string const& class_mask) const {
+    // the mask is resolved to a class once, only the detections of that class are labelled with strings
+    DetectionSet dets = detectSet(img);
+    return dets.selectClass(dets.classIdOf(class_mask)).toDetections();
 }
 
 void Detector::drawBox(cv::Mat& img, std::vector<Detection> const& dets) {
@@ -174,124 +220,4 @@ void Detector::drawBox(cv::Mat& img, std::vector<Detection> const& dets) {
     }
 }
 
-float Detector::iou(const float A[], const float B[]) {
-    using namespace std;
-
-    if (A[0] > B[2] || A[1] > B[3] || A[2] < B[0] || A[3] < B[1]) return 0;
-
-    const float x1 = max(A[0], B[0]);
-    const float y1 = max(A[1], B[1]);
-    const float x2 = min(A[2], B[2]);
-    const float y2 = min(A[3], B[3]);
-
-    const float width = max(0.0f, x2 - x1 + 1.0f);
-    const float height = max(0.0f, y2 - y1 + 1.0f);
-    const float area = width * height;
-
-    const float A_area = (A[2] - A[0] + 1.0f) * (A[3] - A[1] + 1.0f);
-    const float B_area = (B[2] - B[0] + 1.0f) * (B[3] - B[1] + 1.0f);
-
-    return area / (A_area + B_area - area);
-}
-
-void Detector::nms(int* keep_out, int* num_out, const float* boxes_host, int boxes_num, int boxes_dim, float nms_overlap_thresh) {
-    using namespace std;
-
-    int count = 0;
-    vector<char> is_dead(boxes_num, 0);
-
-    for (int i = 0; i < boxes_num; ++i) {
-        if (is_dead[i]) continue;
-        keep_out[count++] = i;
-        for (int j = i + 1; j < boxes_num; ++j) {
-            if (!is_dead[j] && iou(&boxes_host[i * 5], &boxes_host[j * 5])>nms_overlap_thresh) {
-                is_dead[j] = 1;
-            }
-        }
-    }
-    *num_out = count;
-    is_dead.clear();
-}
-
-/*
-* ===  FUNCTION  ======================================================================
-*         Name:  boxes_sort
-*  Description:  Sort the bounding box according score
-* =====================================================================================
-*/
-void Detector::boxes_sort(const int num, const float* pred, float* sorted_pred) {
-    using namespace std;
-
-    vector<Info> my;
-    Info tmp;
-    for (int i = 0; i < num; i++) {
-        tmp.score = pred[i * 5 + 4];
-        tmp.head = pred + i * 5;
-        my.push_back(tmp);
-    }
-
-    std::sort(my.begin(), my.end(),
-              [](Info const& info1, Info const& info2) { return info1.score > info2.score; });
-
-    for (int i = 0; i < num; i++) {
-        for (int j = 0; j < 5; j++) {
-            sorted_pred[i * 5 + j] = my[i].head[j];
-        }
-    }
-}
-
-/*
-* ===  FUNCTION  ======================================================================
-*         Name:  bbox_transform_inv
-*  Description:  Compute bounding box regression value
-* =====================================================================================
-*/
-void Detector::bbox_transform_inv(int num, const float* box_deltas, const float* pred_cls, float* boxes, float* pred, int img_height, int img_width) const {
-    using namespace std;
-
-    float width, height, ctr_x, ctr_y, dx, dy, dw, dh, pred_ctr_x, pred_ctr_y, pred_w, pred_h;
-    for (int i = 0; i < num; i++) {
-        width = float(boxes[i * 4 + 2] - boxes[i * 4 + 0] + 1.0);
-        height = float(boxes[i * 4 + 3] - boxes[i * 4 + 1] + 1.0);
-        ctr_x = float(boxes[i * 4 + 0] + 0.5 * width);
-        ctr_y = float(boxes[i * 4 + 1] + 0.5 * height);
-        int class_num = int(m_classes.size());
-        for (int j = 0; j < class_num; j++) {
-            dx = box_deltas[(i*class_num + j) * 4 + 0];
-            dy = box_deltas[(i*class_num + j) * 4 + 1];
-            dw = box_deltas[(i*class_num + j) * 4 + 2];
-            dh = box_deltas[(i*class_num + j) * 4 + 3];
-            pred_ctr_x = ctr_x + width*dx;
-            pred_ctr_y = ctr_y + height*dy;
-            pred_w = width * exp(dw);
-            pred_h = height * exp(dh);
-            pred[(j*num + i) * 5 + 0] = float(max(min(pred_ctr_x - 0.5* pred_w, (img_width - 1)*1.0), 0.0));
-            pred[(j*num + i) * 5 + 1] = float(max(min(pred_ctr_y - 0.5* pred_h, (img_height - 1)*1.0), 0.0));
-            pred[(j*num + i) * 5 + 2] = float(max(min(pred_ctr_x + 0.5* pred_w, (img_width - 1)*1.0), 0.0));
-            pred[(j*num + i) * 5 + 3] = float(max(min(pred_ctr_y + 0.5* pred_h, (img_height - 1)*1.0), 0.0));
-            pred[(j*num + i) * 5 + 4] = pred_cls[i*class_num + j];
-        }
-    }
-}
-
-std::vector<Detection> Detector::overThresh(int* keep, int num_out, float* sorted_pred_cls, float CONF_THRESH, std::string label) const {
-    using namespace std;
-    using namespace cv;
-
-    vector<Detection> dets;
-    int i = 0;
-    while (i < num_out) {
-        if (sorted_pred_cls[keep[i] * 5 + 4] < CONF_THRESH)
-            break;
-        Detection det;
-        det.label = label;
-        det.rect = Rect(Point(int(round(sorted_pred_cls[keep[i] * 5 + 0])), int(round(sorted_pred_cls[keep[i] * 5 + 1]))),
-                        Point(int(round(sorted_pred_cls[keep[i] * 5 + 2])), int(round(sorted_pred_cls[keep[i] * 5 + 3]))));
-        det.score = sorted_pred_cls[keep[i] * 5 + 4];
-        dets.push_back(det);
-        ++i;
-    }
-    return dets;
-}
-
 } // end namespace cz
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include "metrics.h"
+
+
+namespace cz {
+namespace metrics {
+
+namespace detail {
+std::atomic<bool> enabled(false);
+}
+
+namespace {
+
+template <typename Metric>
+struct Family {
+    std::string help;
+    std::map<std::string, std::unique_ptr<Metric>> byLabels; // map nodes never move, so references stay valid
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, Family<Counter>> counters;
+    std::map<std::string, Family<Histogram>> histograms;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+template <typename Metric>
+Metric& getOrCreate(std::map<std::string, Family<Metric>>& families,
+                    std::string const& name, std::string const& help, std::string const& labels) {
+    Family<Metric>& family = families[name];
+    if (family.help.empty()) family.help = help;
+
+    std::unique_ptr<Metric>& metric = family.byLabels[labels];
+    if (!metric) metric.reset(new Metric());
+    return *metric;
+}
+
+std::string withLabel(std::string const& labels, std::string const& extra) {
+    if (labels.empty()) return "{" + extra + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+std::string braced(std::string const& labels) {
+    return labels.empty() ? std::string() : "{" + labels + "}";
+}
+
+} // end namespace
+
+void setEnabled(bool enabled) {
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Counter::add(uint64_t n) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const {
+    return value_.load(std::memory_order_relaxed);
+}
+
+int Histogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) return static_cast<int>(value);
+
+    int exponent = 63 - __builtin_clzll(value); // at least 4 as SUB_BUCKETS is 16
+    int shift = exponent - 4;
+    int sub = static_cast<int>(value >> shift) - SUB_BUCKETS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + sub;
+}
+
+double Histogram::bucketMidpoint(int index) {
+    if (index < SUB_BUCKETS) return index;
+
+    int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    int sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    double lower = static_cast<double>(static_cast<uint64_t>(SUB_BUCKETS + sub) << shift);
+    double width = static_cast<double>(uint64_t(1) << shift);
+    return lower + (width - 1) / 2;
+}
+
+void Histogram::record(uint64_t value) {
+    buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::count() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::sum() const {
+    return sum_.load(std::memory_order_relaxed);
+}
+
+double Histogram::quantile(double q) const {
+    // the buckets are read one by one while being updated, so their total may differ slightly from count_
+    uint64_t total = 0;
+    for (auto const& bucket : buckets_) total += bucket.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(q * total);
+    if (rank >= total) rank = total - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen > rank) return bucketMidpoint(i);
+    }
+    return bucketMidpoint(NUM_BUCKETS - 1);
+}
+
+Counter& counter(std::string const& name, std::string const& help, std::string const& labels) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return getOrCreate(reg.counters, name, help, labels);
+}
+
+Histogram& histogram(std::string const& name, std::string const& help, std::string const& labels) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return getOrCreate(reg.histograms, name, help, labels);
+}
+
+void writePrometheus(std::ostream& strm) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    for (auto const& familyItem : reg.counters) {
+        std::string const& name = familyItem.first;
+        strm << "# HELP " << name << " " << familyItem.second.help << "\n";
+        strm << "# TYPE " << name << " counter\n";
+        for (auto const& metricItem : familyItem.second.byLabels) {
+            strm << name << braced(metricItem.first) << " " << metricItem.second->value() << "\n";
+        }
+    }
+
+    for (auto const& familyItem : reg.histograms) {
+        std::string const& name = familyItem.first;
+        strm << "# HELP " << name << " " << familyItem.second.help << "\n";
+        strm << "# TYPE " << name << " summary\n";
+        for (auto const& metricItem : familyItem.second.byLabels) {
+            std::string const& labels = metricItem.first;
+            Histogram const& hist = *metricItem.second;
+            for (char const* q : {"0.5", "0.95", "0.99"}) {
+                strm << name << withLabel(labels, std::string("quantile=\"") + q + "\"") << " "
+                     << hist.quantile(std::stod(q)) << "\n";
+            }
+            strm << name << "_sum" << braced(labels) << " " << hist.sum() << "\n";
+            strm << name << "_count" << braced(labels) << " " << hist.count() << "\n";
+        }
+    }
+}
+
+bool writePrometheusTextfile(std::string const& path) {
+    std::string pathTemp = path + ".tmp";
+    {
+        std::ofstream file(pathTemp);
+        if (!file) return false;
+        writePrometheus(file);
+        if (!file) return false;
+    }
+    return std::rename(pathTemp.c_str(), path.c_str()) == 0;
+}
+
+TextfileExporter::~TextfileExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+TextfileExporter::TextfileExporter(std::string path, int intervalMs)
+        : path_(std::move(path)), intervalMs_(intervalMs), thread_(&TextfileExporter::run, this) {}
+
+void TextfileExporter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool stopping = false;
+    while (!stopping) {
+        stopping = cv_.wait_for(lock, std::chrono::milliseconds(intervalMs_), [this] { return stopping_; });
+
+        // also written once more on shutdown, so that the last counts are not lost
+        lock.unlock();
+        writePrometheusTextfile(path_);
+        lock.lock();
+    }
+}
+
+} // end namespace metrics
+} // end namespace cz
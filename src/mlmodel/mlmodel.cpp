@@ -11,4 +11,13 @@ MlModel::~MlModel() = default;
 
 MlModel::MlModel() = default;
 
+ForwardStats const& MlModel::forwardStats() const {
+    return forwardStats_;
+}
+
+void MlModel::countForward(long numInputPixels) const {
+    ++forwardStats_.numForwards;
+    forwardStats_.numInputPixels += numInputPixels;
+}
+
 } // end namespace cz
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <random>
+#include <thread>
+#include "mock_backend.h"
+
+
+namespace cz {
+
+// fixture format, one record per input:
+//   D <hash> <count>, followed by <count> lines of "<label> <x> <y> <width> <height> <score>"
+//   C <hash> <count>, followed by <count> lines of "<label> <score>"
+
+MockBackend::~MockBackend() = default;
+
+MockBackend::MockBackend(std::vector<std::string> labels, MockOptions options)
+        : labels_(std::move(labels)), options_(std::move(options)) {
+    if (!options_.fixturePath.empty()) loadFixture(options_.fixturePath);
+}
+
+// all the models recording into the same fixture share one stream, so that their records never interleave
+std::shared_ptr<MockBackend> MockBackend::recorder(std::string const& fixturePath) {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::shared_ptr<MockBackend>> recorders;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::shared_ptr<MockBackend>& backend = recorders[fixturePath];
+    if (!backend) {
+        backend = std::make_shared<MockBackend>(std::vector<std::string>(), MockOptions());
+        backend->recording_ = true;
+        backend->recordFile_.open(fixturePath, std::ios::app);
+    }
+    return backend;
+}
+
+bool MockBackend::isRecording() const {
+    return recording_;
+}
+
+void MockBackend::simulateLatency() const {
+    if (options_.latencyMs <= 0) return;
+
+    auto duration = std::chrono::duration<double, std::milli>(options_.latencyMs);
+    if (!options_.busyWait) {
+        std::this_thread::sleep_for(duration);
+        return;
+    }
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+    while (std::chrono::steady_clock::now() < end) {}
+}
+
+std::vector<Detection> MockBackend::detect(uint64_t inputHash, cv::Size const& inputSize, float confThresh) const {
+    std::vector<Detection> dets;
+    auto itr = fixtureDetections_.find(inputHash);
+    if (itr != fixtureDetections_.end()) {
+        dets = itr->second;
+    } else {
+        dets = synthesizeDetections(inputHash, inputSize);
+    }
+
+    dets.erase(std::remove_if(dets.begin(), dets.end(), [&](Detection const& det) { return det.score < confThresh; }),
+               dets.end());
+    return dets;
+}
+
+std::vector<Classification> MockBackend::classify(uint64_t inputHash, int n) const {
+    auto itr = fixtureClassifications_.find(inputHash);
+    if (itr != fixtureClassifications_.end()) {
+        std::vector<Classification> clss = itr->second;
+        if (clss.size() > n) clss.resize(n);
+        return clss;
+    }
+
+    std::vector<Classification> clss;
+    if (labels_.empty()) return clss;
+
+    std::mt19937_64 rng(inputHash);
+    std::uniform_real_distribution<float> top(0.5, 1);
+    float score = top(rng);
+    for (int i = 0; i < std::min<int>(n, labels_.size()); ++i) {
+        clss.emplace_back(labels_[rng() % labels_.size()], score);
+        score *= 0.5f * (1 - score);
+    }
+    return clss;
+}
+
+void MockBackend::recordDetections(uint64_t inputHash, std::vector<Detection> const& dets) {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    recordFile_ << "D " << inputHash << " " << dets.size() << "\n";
+    for (auto const& det : dets) {
+        recordFile_ << det.label << " " << det.rect.x << " " << det.rect.y << " "
+                    << det.rect.width << " " << det.rect.height << " " << det.score << "\n";
+    }
+    recordFile_.flush();
+}
+
+void MockBackend::recordClassifications(uint64_t inputHash, std::vector<Classification> const& clss) {
+    std::lock_guard<std::mutex> lock(recordMutex_);
+    recordFile_ << "C " << inputHash << " " << clss.size() << "\n";
+    for (auto const& cls : clss) {
+        recordFile_ << cls.label << " " << cls.score << "\n";
+    }
+    recordFile_.flush();
+}
+
+// a fast non-cryptographic hash of the pixel bytes, which are read 8 bytes at a time
+uint64_t MockBackend::hashPixels(cv::Mat const& img, uint64_t seed) {
+    uint64_t hash = hashCombine(seed, (static_cast<uint64_t>(img.rows) << 32) | static_cast<uint32_t>(img.cols));
+    size_t rowBytes = img.cols * img.elemSize();
+    for (int i = 0; i < img.rows; ++i) {
+        uchar const* row = img.ptr<uchar>(i);
+        size_t j = 0;
+        for (; j + 8 <= rowBytes; j += 8) {
+            uint64_t word;
+            std::memcpy(&word, row + j, 8);
+            hash = (hash ^ word) * 0x100000001b3ULL;
+            hash ^= hash >> 29;
+        }
+        for (; j < rowBytes; ++j) {
+            hash = (hash ^ row[j]) * 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+uint64_t MockBackend::hashCombine(uint64_t seed, uint64_t value) {
+    // the finalizer of splitmix64
+    uint64_t z = seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void MockBackend::loadFixture(std::string const& path) {
+    std::ifstream file(path);
+    char kind;
+    uint64_t hash;
+    int count;
+    while (file >> kind >> hash >> count) {
+        if (kind == 'D') {
+            std::vector<Detection>& dets = fixtureDetections_[hash];
+            dets.clear();
+            for (int i = 0; i < count; ++i) {
+                Detection det;
+                file >> det.label >> det.rect.x >> det.rect.y >> det.rect.width >> det.rect.height >> det.score;
+                dets.push_back(std::move(det));
+            }
+        } else {
+            std::vector<Classification>& clss = fixtureClassifications_[hash];
+            clss.clear();
+            for (int i = 0; i < count; ++i) {
+                Classification cls;
+                file >> cls.label >> cls.score;
+                clss.push_back(std::move(cls));
+            }
+        }
+    }
+}
+
+std::vector<Detection> MockBackend::synthesizeDetections(uint64_t inputHash, cv::Size const& inputSize) const {
+    std::vector<Detection> dets;
+    if (labels_.size() < 2 || inputSize.area() == 0) return dets;
+
+    std::mt19937_64 rng(inputHash);
+    std::uniform_real_distribution<float> score(0.3, 1);
+    std::uniform_int_distribution<int> jitter(-1, 1);
+    int numClasses = static_cast<int>(labels_.size()) - 1;
+
+    if (inputSize.width >= 2 * inputSize.height) {
+        // a line of characters filling the region
+        int charHeight = std::max(1, static_cast<int>(inputSize.height * 0.7));
+        int charWidth = std::max(1, static_cast<int>(charHeight * 0.55));
+        int pitch = std::max(1, static_cast<int>(charWidth * 1.15));
+        int y = (inputSize.height - charHeight) / 2;
+        for (int x = pitch / 2; x + charWidth <= inputSize.width - pitch / 2; x += pitch) {
+            cv::Rect rect(x + jitter(rng), y + jitter(rng), charWidth, charHeight);
+            dets.emplace_back(labels_[1 + rng() % numClasses], rect & cv::Rect(cv::Point(), inputSize), score(rng));
+        }
+    } else {
+        // a column of distinct classes along the left of the region
+        int numRows = std::min(numClasses, 12);
+        int rowHeight = inputSize.height / (numRows + 2);
+        for (int i = 0; i < numRows; ++i) {
+            cv::Rect rect(inputSize.width / 10 + jitter(rng), (i + 1) * rowHeight + jitter(rng),
+                          inputSize.width / 5, std::max(1, rowHeight / 2));
+            dets.emplace_back(labels_[1 + i], rect & cv::Rect(cv::Point(), inputSize), score(rng));
+        }
+    }
+    return dets;
+}
+
+} // end namespace cz
@@ -0,0 +1,208 @@
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "model_profiler.h"
+#include "normalized_image.h"
+
+
+namespace cz {
+
+namespace {
+
+std::string jsonEscape(std::string const& str) {
+    std::string escaped;
+    for (char c : str) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // end namespace
+
+ModelProfiler::~ModelProfiler() = default;
+
+ModelProfiler::ModelProfiler(std::string const& model_file, std::string const& trained_file) {
+    net_ = std::make_shared<caffe::Net<float>>(model_file, caffe::TEST);
+    net_->CopyTrainedLayersFrom(trained_file);
+}
+
+void ModelProfiler::setInputShape(std::string const& blob_name, std::vector<int> const& shape) {
+    auto blob = net_->blob_by_name(blob_name);
+    if (!blob) throw std::invalid_argument("No blob named '" + blob_name + "' in the network.");
+
+    blob->Reshape(shape);
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> pixel(-128, 128);
+    float* data = blob->mutable_cpu_data();
+    for (int i = 0; i < blob->count(); ++i) {
+        data[i] = pixel(rng);
+    }
+
+    updateImInfo();
+    net_->Reshape();
+}
+
+void ModelProfiler::setInputImage(cv::Mat const& img) {
+    auto blob = net_->blob_by_name("data");
+    if (!blob || blob->num_axes() != 4 || blob->channels() != 3) {
+        throw std::invalid_argument("The network has no 3-channel 'data' blob.");
+    }
+
+    int height = blob->height(), width = blob->width();
+    NormalizedImage normalized(img);
+    float* input_data = blob->mutable_cpu_data();
+    for (int i = 0; i < 3; ++i) {
+        cv::Mat channel(height, width, CV_32FC1, input_data);
+        cv::resize(normalized.plane(i), channel, cv::Size(width, height));
+        input_data += height * width;
+    }
+}
+
+// im_info holds the height, width and scales of the input for Faster R-CNN style networks
+void ModelProfiler::updateImInfo() {
+    if (!net_->has_blob("im_info") || !net_->has_blob("data")) return;
+
+    auto data = net_->blob_by_name("data");
+    auto imInfo = net_->blob_by_name("im_info");
+    if (data->num_axes() != 4) return;
+
+    float* info = imInfo->mutable_cpu_data();
+    for (int i = 0; i < imInfo->count(); ++i) {
+        info[i] = 1;
+    }
+    if (imInfo->count() >= 2) {
+        info[0] = data->height();
+        info[1] = data->width();
+    }
+}
+
+void ModelProfiler::profile(int numRuns, int numWarmupRuns) {
+    using Clock = std::chrono::steady_clock;
+
+    int numLayers = static_cast<int>(net_->layers().size());
+    for (int run = 0; run < numWarmupRuns; ++run) {
+        net_->ForwardFromTo(0, numLayers - 1);
+    }
+
+    collectLayerStats();
+
+    for (int run = 0; run < numRuns; ++run) {
+        for (int i = 0; i < numLayers; ++i) {
+            auto start = Clock::now();
+            net_->ForwardFromTo(i, i);
+            layers_[i].wallMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+    }
+
+    if (numRuns > 0) {
+        for (auto& layer : layers_) {
+            layer.wallMs /= numRuns;
+        }
+    }
+}
+
+// shapes, parameter sizes and FLOPs of every layer, as of the last forward
+void ModelProfiler::collectLayerStats() {
+    auto const& layers = net_->layers();
+    layers_.assign(layers.size(), LayerProfile());
+
+    for (int i = 0; i < layers.size(); ++i) {
+        LayerProfile& profile = layers_[i];
+        caffe::Layer<float>& layer = *layers[i];
+        profile.name = net_->layer_names()[i];
+        profile.type = layer.type();
+
+        long topCount = 0;
+        for (caffe::Blob<float> const* top : net_->top_vecs()[i]) {
+            profile.topShapes.push_back(top->shape_string());
+            topCount += top->count();
+        }
+        profile.topBytes = topCount * sizeof(float);
+
+        for (auto const& param : layer.blobs()) {
+            profile.paramBytes += param->count() * sizeof(float);
+        }
+
+        bool hasWeights = !layer.blobs().empty() && layer.blobs().front()->num_axes() >= 2;
+        if (hasWeights && (profile.type == "Convolution" || profile.type == "InnerProduct")) {
+            // weights are shaped (outputs, inputs per output, ...), each output element takes one multiply-add per weight
+            caffe::Blob<float> const& weights = *layer.blobs().front();
+            double macsPerOutput = static_cast<double>(weights.count()) / weights.shape(0);
+            profile.flops = 2 * topCount * macsPerOutput;
+            if (layer.blobs().size() > 1) profile.flops += topCount; // bias
+        } else if (hasWeights && profile.type == "Deconvolution") {
+            // weights are shaped (inputs, outputs per input, ...), so the count runs over the bottom instead
+            caffe::Blob<float> const& weights = *layer.blobs().front();
+            long bottomCount = net_->bottom_vecs()[i].front()->count();
+            profile.flops = 2.0 * bottomCount * weights.count() / weights.shape(0);
+            if (layer.blobs().size() > 1) profile.flops += topCount;
+        } else {
+            profile.flops = topCount;
+        }
+    }
+}
+
+std::vector<LayerProfile> const& ModelProfiler::layers() const {
+    return layers_;
+}
+
+double ModelProfiler::totalWallMs() const {
+    double sum = 0;
+    for (auto const& layer : layers_) sum += layer.wallMs;
+    return sum;
+}
+
+double ModelProfiler::totalFlops() const {
+    double sum = 0;
+    for (auto const& layer : layers_) sum += layer.flops;
+    return sum;
+}
+
+void ModelProfiler::printTable(std::ostream& strm) const {
+    double totalMs = totalWallMs();
+
+    strm << std::left << std::setw(5) << "#" << std::setw(32) << "layer" << std::setw(20) << "type"
+         << std::right << std::setw(10) << "ms" << std::setw(8) << "%"
+         << std::setw(12) << "MFLOPs" << std::setw(12) << "params KB" << std::setw(12) << "top KB"
+         << "  top shapes" << std::endl;
+
+    strm << std::fixed;
+    for (int i = 0; i < layers_.size(); ++i) {
+        LayerProfile const& layer = layers_[i];
+        strm << std::left << std::setw(5) << i << std::setw(32) << layer.name << std::setw(20) << layer.type
+             << std::right << std::setprecision(3) << std::setw(10) << layer.wallMs
+             << std::setprecision(1) << std::setw(8) << (totalMs > 0 ? 100 * layer.wallMs / totalMs : 0)
+             << std::setw(12) << layer.flops / 1e6
+             << std::setw(12) << layer.paramBytes / 1024.0 << std::setw(12) << layer.topBytes / 1024.0 << " ";
+        for (auto const& shape : layer.topShapes) strm << " " << shape;
+        strm << std::endl;
+    }
+
+    strm << std::left << std::setw(57) << "total" << std::right
+         << std::setprecision(3) << std::setw(10) << totalMs << std::setw(8) << ""
+         << std::setprecision(1) << std::setw(12) << totalFlops() / 1e6 << std::endl;
+    strm << std::defaultfloat;
+}
+
+void ModelProfiler::printJson(std::ostream& strm) const {
+    strm << "{\"total_ms\": " << totalWallMs() << ", \"total_flops\": " << totalFlops() << ", \"layers\": [";
+    for (int i = 0; i < layers_.size(); ++i) {
+        LayerProfile const& layer = layers_[i];
+        if (i > 0) strm << ", ";
+        strm << "{\"name\": \"" << jsonEscape(layer.name) << "\", \"type\": \"" << jsonEscape(layer.type) << "\""
+             << ", \"ms\": " << layer.wallMs << ", \"flops\": " << layer.flops
+             << ", \"param_bytes\": " << layer.paramBytes << ", \"top_bytes\": " << layer.topBytes
+             << ", \"top_shapes\": [";
+        for (int j = 0; j < layer.topShapes.size(); ++j) {
+            if (j > 0) strm << ", ";
+            strm << "\"" << jsonEscape(layer.topShapes[j]) << "\"";
+        }
+        strm << "]}";
+    }
+    strm << "]}" << std::endl;
+}
+
+} // end namespace cz
@@ -0,0 +1,59 @@
+#include "normalized_image.h"
+#include <cassert>
+
+
+namespace cz {
+
+float const NormalizedImage::PIXEL_MEANS[3] = {102.9801f, 115.9465f, 122.7717f};
+
+NormalizedImage::~NormalizedImage() = default;
+
+NormalizedImage::NormalizedImage() = default;
+
+NormalizedImage::NormalizedImage(cv::Mat const& img) {
+    assign(img);
+}
+
+void NormalizedImage::assign(cv::Mat const& img) {
+    assert(img.type() == CV_8UC3);
+
+    source_ = img;
+    data_.create(img.rows * 3, img.cols, CV_32FC1);
+    for (int c = 0; c < 3; ++c) {
+        planes_[c] = data_.rowRange(c * img.rows, (c + 1) * img.rows);
+    }
+
+    for (int h = 0; h < img.rows; ++h) {
+        uchar const* src = img.ptr<uchar>(h);
+        float* dstB = planes_[0].ptr<float>(h);
+        float* dstG = planes_[1].ptr<float>(h);
+        float* dstR = planes_[2].ptr<float>(h);
+        for (int w = 0; w < img.cols; ++w) {
+            dstB[w] = float(src[3 * w + 0]) - PIXEL_MEANS[0];
+            dstG[w] = float(src[3 * w + 1]) - PIXEL_MEANS[1];
+            dstR[w] = float(src[3 * w + 2]) - PIXEL_MEANS[2];
+        }
+    }
+}
+
+void NormalizedImage::invalidate() {
+    source_.release();
+}
+
+bool NormalizedImage::isNormalizedFrom(cv::Mat const& img) const {
+    return !source_.empty() && source_.data == img.data && source_.size() == img.size() && source_.step == img.step;
+}
+
+bool NormalizedImage::empty() const {
+    return source_.empty();
+}
+
+cv::Size NormalizedImage::size() const {
+    return source_.size();
+}
+
+cv::Mat const& NormalizedImage::plane(int channel) const {
+    return planes_[channel];
+}
+
+} // end namespace cz
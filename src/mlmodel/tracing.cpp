@@ -0,0 +1,166 @@
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "tracing.h"
+
+
+namespace cz {
+namespace tracing {
+
+namespace detail {
+std::atomic<bool> enabled(false);
+}
+
+namespace {
+
+int const RING_CAPACITY = 1 << 14; // events per thread
+
+struct Event {
+    // odd while the slot is being written, guards the slot against torn reads during a dump
+    // the fields are atomic as well since a dump may read them while they are written, relaxed accesses suffice
+    // as the fences around them order them against seq
+    std::atomic<uint64_t> seq{0};
+    std::atomic<char const*> name{nullptr};
+    std::atomic<char const*> category{nullptr};
+    std::atomic<uint64_t> beginUs{0};
+    std::atomic<uint64_t> endUs{0};
+};
+
+// written only by its owner thread, read concurrently by dumps
+struct ThreadBuffer {
+    int tid;
+    std::atomic<uint64_t> head{0};
+    std::vector<Event> events;
+
+    explicit ThreadBuffer(int _tid) : tid(_tid), events(RING_CAPACITY) {}
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers; // kept after their threads exit so that their events can be dumped
+
+    std::mutex dumpMutex;
+    int dumpEveryNRequests = 0;
+    std::string dumpPathPrefix;
+    std::atomic<long> numRequests{0};
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer = std::make_shared<ThreadBuffer>(static_cast<int>(reg.buffers.size()) + 1);
+        reg.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+std::string jsonEscape(char const* str) {
+    std::string escaped;
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') escaped += '\\';
+        escaped += *str;
+    }
+    return escaped;
+}
+
+} // end namespace
+
+void setEnabled(bool enabled) {
+    detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t nowUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void record(char const* name, char const* category, uint64_t beginUs, uint64_t endUs) {
+    ThreadBuffer& buffer = threadBuffer();
+    uint64_t pos = buffer.head.load(std::memory_order_relaxed);
+    Event& event = buffer.events[pos % RING_CAPACITY];
+
+    event.seq.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.category.store(category, std::memory_order_relaxed);
+    event.beginUs.store(beginUs, std::memory_order_relaxed);
+    event.endUs.store(endUs, std::memory_order_relaxed);
+    event.seq.store(2 * pos + 2, std::memory_order_release);
+
+    buffer.head.store(pos + 1, std::memory_order_release);
+}
+
+void writeChromeTrace(std::ostream& strm) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffers = reg.buffers;
+    }
+
+    strm << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (auto const& buffer : buffers) {
+        strm << (first ? "" : ",") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+             << ", \"args\": {\"name\": \"thread " << buffer->tid << "\"}}";
+        first = false;
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t tail = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+        for (uint64_t pos = tail; pos < head; ++pos) {
+            Event const& event = buffer->events[pos % RING_CAPACITY];
+
+            uint64_t seqBefore = event.seq.load(std::memory_order_acquire);
+            char const* name = event.name.load(std::memory_order_relaxed);
+            char const* category = event.category.load(std::memory_order_relaxed);
+            uint64_t beginUs = event.beginUs.load(std::memory_order_relaxed);
+            uint64_t endUs = event.endUs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t seqAfter = event.seq.load(std::memory_order_relaxed);
+            // skip slots overwritten by the owner thread meanwhile
+            if (seqBefore != 2 * pos + 2 || seqAfter != seqBefore) continue;
+
+            strm << ",\n{\"name\": \"" << jsonEscape(name) << "\", \"cat\": \"" << jsonEscape(category)
+                 << "\", \"ph\": \"X\", \"ts\": " << beginUs << ", \"dur\": " << endUs - beginUs
+                 << ", \"pid\": 1, \"tid\": " << buffer->tid << "}";
+        }
+    }
+    strm << "\n]}" << std::endl;
+}
+
+bool writeChromeTrace(std::string const& path) {
+    std::ofstream file(path);
+    if (!file) return false;
+    writeChromeTrace(file);
+    return static_cast<bool>(file);
+}
+
+void setAutoDump(int everyNRequests, std::string const& pathPrefix) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.dumpMutex);
+    reg.dumpEveryNRequests = everyNRequests;
+    reg.dumpPathPrefix = pathPrefix;
+}
+
+void countRequest() {
+    if (!isEnabled()) return;
+
+    Registry& reg = registry();
+    long count = ++reg.numRequests;
+
+    std::lock_guard<std::mutex> lock(reg.dumpMutex);
+    if (reg.dumpEveryNRequests <= 0 || count % reg.dumpEveryNRequests != 0) return;
+    writeChromeTrace(reg.dumpPathPrefix + "-" + std::to_string(count) + ".json");
+}
+
+} // end namespace tracing
+} // end namespace cz